@@ -0,0 +1,185 @@
+#include "AudioOutput.h"
+#include <chrono>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#include <mmsystem.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+static void WriteU16(std::ofstream& file, U16 value) {
+	U8 bytes[2] = { (U8)value, (U8)(value >> 8) };
+	file.write((const char*)bytes, sizeof(bytes));
+}
+
+static void WriteU32(std::ofstream& file, U32 value) {
+	U8 bytes[4] = { (U8)value, (U8)(value >> 8), (U8)(value >> 16), (U8)(value >> 24) };
+	file.write((const char*)bytes, sizeof(bytes));
+}
+
+bool WavWriter::Open(const char* path) {
+	m_File.open(path, std::ios::binary | std::ios::trunc);
+	if (!m_File)
+		return false;
+	m_Samples = 0;
+
+	//RIFF header and fmt chunk, the two sizes are written again by Close
+	m_File.write("RIFF", 4);
+	WriteU32(m_File, 0);
+	m_File.write("WAVEfmt ", 8);
+	WriteU32(m_File, 16);
+	WriteU16(m_File, 1);
+	WriteU16(m_File, 1);
+	WriteU32(m_File, Beeper::SAMPLE_RATE);
+	WriteU32(m_File, Beeper::SAMPLE_RATE * 2);
+	WriteU16(m_File, 2);
+	WriteU16(m_File, 16);
+	m_File.write("data", 4);
+	WriteU32(m_File, 0);
+	return (bool)m_File;
+}
+
+void WavWriter::Write(const short* samples, int count) {
+	for (int i = 0; i < count; i++)
+		WriteU16(m_File, (U16)samples[i]);
+	m_Samples += count;
+}
+
+bool WavWriter::Close() {
+	if (!m_File.is_open())
+		return false;
+	U32 dataBytes = m_Samples * 2;
+	m_File.seekp(4);
+	WriteU32(m_File, 36 + dataBytes);
+	m_File.seekp(40);
+	WriteU32(m_File, dataBytes);
+	bool ok = (bool)m_File;
+	m_File.close();
+	return ok;
+}
+
+AudioOutput::AudioOutput() : m_Beeper(nullptr), m_Stop(false), m_Device(nullptr) {
+}
+
+AudioOutput::~AudioOutput() {
+	Stop();
+}
+
+bool AudioOutput::Start(Beeper& beeper, Sink sink, const char* path) {
+	Stop();
+	m_Beeper = &beeper;
+	m_Stop = false;
+	if (sink == SINK_DEVICE) {
+		if (!OpenDevice())
+			return false;
+		m_Thread = std::thread([this]() { RunDevice(); });
+		return true;
+	}
+	if (sink == SINK_WAV && !m_Wav.Open(path))
+		return false;
+	m_Thread = std::thread([this]() { RunTimer(); });
+	return true;
+}
+
+void AudioOutput::Stop() {
+	if (!m_Thread.joinable())
+		return;
+	m_Stop = true;
+	m_Thread.join();
+	CloseDevice();
+	m_Wav.Close();
+}
+
+void AudioOutput::RunTimer() {
+	//Callback n is due when the device would have played n buffers, computed from n so that no rounding adds up
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	short buffer[BUFFER_SAMPLES];
+	for (U64 callback = 1; !m_Stop; callback++) {
+		std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::nanoseconds(callback * BUFFER_SAMPLES * 1000000000 / Beeper::SAMPLE_RATE)));
+		m_Beeper->Read(buffer, BUFFER_SAMPLES);
+		if (m_Wav.IsOpen())
+			m_Wav.Write(buffer, BUFFER_SAMPLES);
+	}
+}
+
+#if defined(_WIN32)
+
+//The wave output signals the event each time it finished a buffer, the thread refills the finished ones in order
+struct AudioOutput::Device {
+	HWAVEOUT handle;
+	HANDLE done;
+	WAVEHDR headers[DEVICE_BUFFERS];
+	short buffers[DEVICE_BUFFERS][BUFFER_SAMPLES];
+};
+
+bool AudioOutput::OpenDevice() {
+	Device* device = new Device();
+	WAVEFORMATEX format = {};
+	format.wFormatTag = WAVE_FORMAT_PCM;
+	format.nChannels = 1;
+	format.nSamplesPerSec = Beeper::SAMPLE_RATE;
+	format.wBitsPerSample = 16;
+	format.nBlockAlign = 2;
+	format.nAvgBytesPerSec = Beeper::SAMPLE_RATE * 2;
+	device->done = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (device->done == NULL || waveOutOpen(&device->handle, WAVE_MAPPER, &format, (DWORD_PTR)device->done, 0, CALLBACK_EVENT) != MMSYSERR_NOERROR) {
+		if (device->done != NULL)
+			CloseHandle(device->done);
+		delete device;
+		return false;
+	}
+
+	//Start with silence, the ring fills while it plays
+	for (int i = 0; i < DEVICE_BUFFERS; i++) {
+		WAVEHDR& header = device->headers[i];
+		header.lpData = (LPSTR)device->buffers[i];
+		header.dwBufferLength = sizeof(device->buffers[i]);
+		waveOutPrepareHeader(device->handle, &header, sizeof(header));
+		waveOutWrite(device->handle, &header, sizeof(header));
+	}
+	m_Device = device;
+	return true;
+}
+
+void AudioOutput::RunDevice() {
+	int next = 0;
+	while (!m_Stop) {
+		WaitForSingleObject(m_Device->done, 100);
+		while ((m_Device->headers[next].dwFlags & WHDR_DONE) != 0 && !m_Stop) {
+			m_Beeper->Read(m_Device->buffers[next], BUFFER_SAMPLES);
+			waveOutWrite(m_Device->handle, &m_Device->headers[next], sizeof(WAVEHDR));
+			next = (next + 1) % DEVICE_BUFFERS;
+		}
+	}
+}
+
+void AudioOutput::CloseDevice() {
+	if (m_Device == nullptr)
+		return;
+	waveOutReset(m_Device->handle);
+	for (int i = 0; i < DEVICE_BUFFERS; i++)
+		waveOutUnprepareHeader(m_Device->handle, &m_Device->headers[i], sizeof(WAVEHDR));
+	waveOutClose(m_Device->handle);
+	CloseHandle(m_Device->done);
+	delete m_Device;
+	m_Device = nullptr;
+}
+
+#else
+
+//No audio device on this platform, use the null or WAV sink
+struct AudioOutput::Device {
+};
+
+bool AudioOutput::OpenDevice() {
+	return false;
+}
+
+void AudioOutput::RunDevice() {
+}
+
+void AudioOutput::CloseDevice() {
+}
+
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <fstream>
+#include <thread>
+
+#include "OpCode.h"
+#include "Beeper.h"
+
+//16 bit mono PCM at the beeper's sample rate. The sizes in the header are filled in by Close.
+struct WavWriter {
+	std::ofstream m_File;
+	U32 m_Samples;
+
+	WavWriter() : m_Samples(0) {}
+
+	bool Open(const char* path);
+	void Write(const short* samples, int count);
+	bool Close();
+	bool IsOpen() const { return m_File.is_open(); }
+};
+
+//Plays a Beeper from an audio callback on a thread of its own, which takes BUFFER_SAMPLES samples from the ring each
+//time the output needs them. The device sink is the Windows wave output. The null and WAV sinks call back from a
+//timer at the same rate a device would, for machines without audio: null throws the samples away, WAV writes them to
+//a file. Either way the ring sees the same consumer as with a device, so latency and underruns are measured alike.
+struct AudioOutput {
+	enum Sink {
+		SINK_NULL,
+		SINK_WAV,
+		SINK_DEVICE
+	};
+	//About 12 ms per callback
+	static const int BUFFER_SAMPLES = 512;
+	//Buffers queued at the device, one playing while the others wait
+	static const int DEVICE_BUFFERS = 3;
+
+	Beeper* m_Beeper;
+	std::thread m_Thread;
+	std::atomic<bool> m_Stop;
+	WavWriter m_Wav;
+	//The open device, defined by the platform
+	struct Device;
+	Device* m_Device;
+
+	AudioOutput();
+	~AudioOutput();
+
+	//path is the file for SINK_WAV. False when the file or the device could not be opened.
+	bool Start(Beeper& beeper, Sink sink, const char* path = nullptr);
+	void Stop();
+	bool IsRunning() const { return m_Thread.joinable(); }
+
+private:
+	bool OpenDevice();
+	void RunDevice();
+	void CloseDevice();
+	void RunTimer();
+};
@@ -0,0 +1,1068 @@
+#include "BatchSuperChip.h"
+#include <cstdlib>
+#include <cstring>
+
+#include "Scroll.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define BATCH_SIMD_ENABLED
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+//MSVC compiles AVX2 intrinsics without /arch:AVX2, GCC and Clang need the target on every function that uses them
+#define BATCH_AVX2_TARGET
+#else
+#define BATCH_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+static int LowestBit(U32 bits) {
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, bits);
+	return (int)index;
+#else
+	return __builtin_ctz(bits);
+#endif
+}
+
+static int CountBits(U32 bits) {
+	bits = bits - ((bits >> 1) & 0x55555555);
+	bits = (bits & 0x33333333) + ((bits >> 2) & 0x33333333);
+	return (int)((((bits + (bits >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24);
+}
+
+//Group kernels. Each one runs the register part of an instruction for the lanes in mask of a block, statement by
+//statement like the interpreter so that instructions naming the same register twice or VF come out the same. reg points
+//to V0 of the first lane of the block and registers are stride bytes apart. Skip instructions return the lanes that skip.
+
+static U32 GroupOpScalar(const DecodedOp& op, U8* reg, int stride, U8* delay, U8* sound, U32 mask) {
+	U32 skip = 0;
+	for (U32 lanes = mask; lanes != 0; lanes &= lanes - 1) {
+		int i = LowestBit(lanes);
+		U8& vx = reg[op.x * stride + i];
+		U8& vy = reg[op.y * stride + i];
+		U8& vf = reg[0xF * stride + i];
+		bool taken = false;
+		switch (op.handler) {
+			case OP_3XNN: taken = vx == op.nn; break;
+			case OP_4XNN: taken = vx != op.nn; break;
+			case OP_5XY0: taken = vx == vy; break;
+			case OP_9XY0: taken = vx != vy; break;
+			case OP_6XNN: vx = op.nn; break;
+			case OP_7XNN: vx += op.nn; break;
+			case OP_8XY0: vx = vy; break;
+			case OP_8XY1: vx |= vy; break;
+			case OP_8XY2: vx &= vy; break;
+			case OP_8XY3: vx ^= vy; break;
+			case OP_8XY4:
+				vx += vy;
+				vf = 0;
+				if (vy > (0xFF - vx))
+					vf = 1;
+				break;
+			case OP_8XY5:
+				vx -= vy;
+				vf = 1;
+				if (vy > (0xFF - vx))
+					vf = 0;
+				break;
+			case OP_8XY6:
+				vf = vx & 1;
+				vx = vx >> 1;
+				break;
+			case OP_8XY7:
+				vx = vy - vx;
+				vf = 1;
+				if (vy < vx)
+					vf = 0;
+				break;
+			case OP_8XYE:
+				vf = vx >> 7;
+				vx = vx << 1;
+				break;
+			case OP_FX07: vx = delay[i]; break;
+			case OP_FX15: delay[i] = vx; break;
+			case OP_FX18: sound[i] = vx; break;
+			default: break;
+		}
+		if (taken)
+			skip |= (U32)1 << i;
+	}
+	return skip;
+}
+
+//Word helpers for the pcs, I and the instruction budgets of a block, one word per lane. Words stay below 0x8000.
+
+static void StoreWordsScalar(U16* words, U32 mask, U16 value) {
+	for (U32 lanes = mask; lanes != 0; lanes &= lanes - 1) {
+		words[LowestBit(lanes)] = value;
+	}
+}
+
+static void AddWordsScalar(U16* words, U32 mask, U16 value) {
+	for (U32 lanes = mask; lanes != 0; lanes &= lanes - 1) {
+		words[LowestBit(lanes)] += value;
+	}
+}
+
+//Smallest word of the lanes in mask
+static U16 MinWordScalar(const U16* words, U32 mask) {
+	U16 least = 0x7FFF;
+	for (U32 lanes = mask; lanes != 0; lanes &= lanes - 1) {
+		int i = LowestBit(lanes);
+		if (words[i] < least)
+			least = words[i];
+	}
+	return least;
+}
+
+//Lanes of a block whose word is value
+static U32 MatchWordsScalar(const U16* words, U16 value) {
+	U32 match = 0;
+	for (int i = 0; i < BatchSuperChip::BLOCK; i++) {
+		if (words[i] == value)
+			match |= (U32)1 << i;
+	}
+	return match;
+}
+
+#if defined(BATCH_SIMD_ENABLED)
+
+//Byte i is 0xFF where bit i of bits is set
+static inline __m128i ByteMaskSse2(U32 bits) {
+	const __m128i select = _mm_set1_epi64x((long long)0x8040201008040201ULL);
+	__m128i spread = _mm_set_epi64x((long long)(((bits >> 8) & 0xFF) * 0x0101010101010101ULL), (long long)((bits & 0xFF) * 0x0101010101010101ULL));
+	return _mm_cmpeq_epi8(_mm_and_si128(spread, select), select);
+}
+
+//Word i is 0xFFFF where bit i of the low 8 bits is set
+static inline __m128i WordMaskSse2(U32 bits) {
+	const __m128i select = _mm_set_epi16(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+	return _mm_cmpeq_epi16(_mm_and_si128(_mm_set1_epi16((short)(bits & 0xFF)), select), select);
+}
+
+static inline __m128i LoadSse2(const U8* bytes) {
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+}
+
+//Writes value to the lanes in lanes, the others keep their byte
+static inline void StoreSse2(U8* bytes, __m128i value, __m128i lanes) {
+	__m128i old = LoadSse2(bytes);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(bytes), _mm_or_si128(_mm_and_si128(lanes, value), _mm_andnot_si128(lanes, old)));
+}
+
+//0xFF where a + b carries, which is b > 0xFF - a
+static inline __m128i CarrySse2(__m128i a, __m128i b) {
+	return _mm_xor_si128(_mm_cmpeq_epi8(_mm_adds_epu8(a, b), _mm_add_epi8(a, b)), _mm_set1_epi8(-1));
+}
+
+static U32 GroupOpSse2(const DecodedOp& op, U8* reg, int stride, U8* delay, U8* sound, U32 mask) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi8(1);
+	U32 skip = 0;
+	for (int half = 0; half < BatchSuperChip::BLOCK; half += 16) {
+		U32 halfMask = (mask >> half) & 0xFFFF;
+		if (halfMask == 0)
+			continue;
+		__m128i lanes = ByteMaskSse2(halfMask);
+		U8* vx = reg + op.x * stride + half;
+		U8* vy = reg + op.y * stride + half;
+		U8* vf = reg + 0xF * stride + half;
+		__m128i taken = zero;
+		switch (op.handler) {
+			case OP_3XNN:
+				taken = _mm_cmpeq_epi8(LoadSse2(vx), _mm_set1_epi8((char)op.nn));
+				break;
+			case OP_4XNN:
+				taken = _mm_andnot_si128(_mm_cmpeq_epi8(LoadSse2(vx), _mm_set1_epi8((char)op.nn)), lanes);
+				break;
+			case OP_5XY0:
+				taken = _mm_cmpeq_epi8(LoadSse2(vx), LoadSse2(vy));
+				break;
+			case OP_9XY0:
+				taken = _mm_andnot_si128(_mm_cmpeq_epi8(LoadSse2(vx), LoadSse2(vy)), lanes);
+				break;
+			case OP_6XNN:
+				StoreSse2(vx, _mm_set1_epi8((char)op.nn), lanes);
+				break;
+			case OP_7XNN:
+				StoreSse2(vx, _mm_add_epi8(LoadSse2(vx), _mm_set1_epi8((char)op.nn)), lanes);
+				break;
+			case OP_8XY0:
+				StoreSse2(vx, LoadSse2(vy), lanes);
+				break;
+			case OP_8XY1:
+				StoreSse2(vx, _mm_or_si128(LoadSse2(vx), LoadSse2(vy)), lanes);
+				break;
+			case OP_8XY2:
+				StoreSse2(vx, _mm_and_si128(LoadSse2(vx), LoadSse2(vy)), lanes);
+				break;
+			case OP_8XY3:
+				StoreSse2(vx, _mm_xor_si128(LoadSse2(vx), LoadSse2(vy)), lanes);
+				break;
+			case OP_8XY4:
+				StoreSse2(vx, _mm_add_epi8(LoadSse2(vx), LoadSse2(vy)), lanes);
+				StoreSse2(vf, zero, lanes);
+				StoreSse2(vf, one, _mm_and_si128(lanes, CarrySse2(LoadSse2(vx), LoadSse2(vy))));
+				break;
+			case OP_8XY5:
+				StoreSse2(vx, _mm_sub_epi8(LoadSse2(vx), LoadSse2(vy)), lanes);
+				StoreSse2(vf, one, lanes);
+				StoreSse2(vf, zero, _mm_and_si128(lanes, CarrySse2(LoadSse2(vx), LoadSse2(vy))));
+				break;
+			case OP_8XY6:
+				StoreSse2(vf, _mm_and_si128(LoadSse2(vx), one), lanes);
+				StoreSse2(vx, _mm_and_si128(_mm_srli_epi16(LoadSse2(vx), 1), _mm_set1_epi8(0x7F)), lanes);
+				break;
+			case OP_8XY7:
+			{
+				StoreSse2(vx, _mm_sub_epi8(LoadSse2(vy), LoadSse2(vx)), lanes);
+				StoreSse2(vf, one, lanes);
+				//VY < VX where the larger of the two is not VY
+				__m128i y = LoadSse2(vy);
+				__m128i below = _mm_xor_si128(_mm_cmpeq_epi8(_mm_max_epu8(y, LoadSse2(vx)), y), _mm_set1_epi8(-1));
+				StoreSse2(vf, zero, _mm_and_si128(lanes, below));
+			}
+				break;
+			case OP_8XYE:
+				StoreSse2(vf, _mm_and_si128(_mm_srli_epi16(LoadSse2(vx), 7), one), lanes);
+				StoreSse2(vx, _mm_add_epi8(LoadSse2(vx), LoadSse2(vx)), lanes);
+				break;
+			case OP_FX07:
+				StoreSse2(vx, LoadSse2(delay + half), lanes);
+				break;
+			case OP_FX15:
+				StoreSse2(delay + half, LoadSse2(vx), lanes);
+				break;
+			case OP_FX18:
+				StoreSse2(sound + half, LoadSse2(vx), lanes);
+				break;
+			default:
+				break;
+		}
+		skip |= ((U32)_mm_movemask_epi8(taken) & halfMask) << half;
+	}
+	return skip;
+}
+
+static void StoreWordsSse2(U16* words, U32 mask, U16 value) {
+	const __m128i values = _mm_set1_epi16((short)value);
+	for (int i = 0; i < BatchSuperChip::BLOCK; i += 8) {
+		if (((mask >> i) & 0xFF) == 0)
+			continue;
+		__m128i lanes = WordMaskSse2(mask >> i);
+		__m128i* target = reinterpret_cast<__m128i*>(words + i);
+		_mm_storeu_si128(target, _mm_or_si128(_mm_and_si128(lanes, values), _mm_andnot_si128(lanes, _mm_loadu_si128(target))));
+	}
+}
+
+static void AddWordsSse2(U16* words, U32 mask, U16 value) {
+	const __m128i values = _mm_set1_epi16((short)value);
+	for (int i = 0; i < BatchSuperChip::BLOCK; i += 8) {
+		if (((mask >> i) & 0xFF) == 0)
+			continue;
+		__m128i* target = reinterpret_cast<__m128i*>(words + i);
+		_mm_storeu_si128(target, _mm_add_epi16(_mm_loadu_si128(target), _mm_and_si128(WordMaskSse2(mask >> i), values)));
+	}
+}
+
+//The other lanes count as 0x7FFF, the signed minimum sees all words as positive
+static U16 MinWordSse2(const U16* words, U32 mask) {
+	const __m128i none = _mm_set1_epi16(0x7FFF);
+	__m128i least = none;
+	for (int i = 0; i < BatchSuperChip::BLOCK; i += 8) {
+		if (((mask >> i) & 0xFF) == 0)
+			continue;
+		__m128i lanes = WordMaskSse2(mask >> i);
+		__m128i word = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i));
+		least = _mm_min_epi16(least, _mm_or_si128(_mm_and_si128(lanes, word), _mm_andnot_si128(lanes, none)));
+	}
+	least = _mm_min_epi16(least, _mm_srli_si128(least, 8));
+	least = _mm_min_epi16(least, _mm_srli_si128(least, 4));
+	least = _mm_min_epi16(least, _mm_srli_si128(least, 2));
+	return (U16)_mm_cvtsi128_si32(least);
+}
+
+static U32 MatchWordsSse2(const U16* words, U16 value) {
+	const __m128i values = _mm_set1_epi16((short)value);
+	U32 match = 0;
+	for (int i = 0; i < BatchSuperChip::BLOCK; i += 16) {
+		__m128i low = _mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i)), values);
+		__m128i high = _mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i + 8)), values);
+		match |= (U32)_mm_movemask_epi8(_mm_packs_epi16(low, high)) << i;
+	}
+	return match;
+}
+
+BATCH_AVX2_TARGET static inline __m256i ByteMaskAvx2(U32 bits) {
+	const __m256i select = _mm256_set1_epi64x((long long)0x8040201008040201ULL);
+	__m256i spread = _mm256_set_epi64x((long long)(((bits >> 24) & 0xFF) * 0x0101010101010101ULL), (long long)(((bits >> 16) & 0xFF) * 0x0101010101010101ULL),
+		(long long)(((bits >> 8) & 0xFF) * 0x0101010101010101ULL), (long long)((bits & 0xFF) * 0x0101010101010101ULL));
+	return _mm256_cmpeq_epi8(_mm256_and_si256(spread, select), select);
+}
+
+BATCH_AVX2_TARGET static inline __m256i LoadAvx2(const U8* bytes) {
+	return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes));
+}
+
+BATCH_AVX2_TARGET static inline void StoreAvx2(U8* bytes, __m256i value, __m256i lanes) {
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(bytes), _mm256_blendv_epi8(LoadAvx2(bytes), value, lanes));
+}
+
+BATCH_AVX2_TARGET static inline __m256i CarryAvx2(__m256i a, __m256i b) {
+	return _mm256_xor_si256(_mm256_cmpeq_epi8(_mm256_adds_epu8(a, b), _mm256_add_epi8(a, b)), _mm256_set1_epi8(-1));
+}
+
+//The whole block in one register
+BATCH_AVX2_TARGET static U32 GroupOpAvx2(const DecodedOp& op, U8* reg, int stride, U8* delay, U8* sound, U32 mask) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i one = _mm256_set1_epi8(1);
+	__m256i lanes = ByteMaskAvx2(mask);
+	U8* vx = reg + op.x * stride;
+	U8* vy = reg + op.y * stride;
+	U8* vf = reg + 0xF * stride;
+	__m256i taken = zero;
+	switch (op.handler) {
+		case OP_3XNN:
+			taken = _mm256_cmpeq_epi8(LoadAvx2(vx), _mm256_set1_epi8((char)op.nn));
+			break;
+		case OP_4XNN:
+			taken = _mm256_andnot_si256(_mm256_cmpeq_epi8(LoadAvx2(vx), _mm256_set1_epi8((char)op.nn)), lanes);
+			break;
+		case OP_5XY0:
+			taken = _mm256_cmpeq_epi8(LoadAvx2(vx), LoadAvx2(vy));
+			break;
+		case OP_9XY0:
+			taken = _mm256_andnot_si256(_mm256_cmpeq_epi8(LoadAvx2(vx), LoadAvx2(vy)), lanes);
+			break;
+		case OP_6XNN:
+			StoreAvx2(vx, _mm256_set1_epi8((char)op.nn), lanes);
+			break;
+		case OP_7XNN:
+			StoreAvx2(vx, _mm256_add_epi8(LoadAvx2(vx), _mm256_set1_epi8((char)op.nn)), lanes);
+			break;
+		case OP_8XY0:
+			StoreAvx2(vx, LoadAvx2(vy), lanes);
+			break;
+		case OP_8XY1:
+			StoreAvx2(vx, _mm256_or_si256(LoadAvx2(vx), LoadAvx2(vy)), lanes);
+			break;
+		case OP_8XY2:
+			StoreAvx2(vx, _mm256_and_si256(LoadAvx2(vx), LoadAvx2(vy)), lanes);
+			break;
+		case OP_8XY3:
+			StoreAvx2(vx, _mm256_xor_si256(LoadAvx2(vx), LoadAvx2(vy)), lanes);
+			break;
+		case OP_8XY4:
+			StoreAvx2(vx, _mm256_add_epi8(LoadAvx2(vx), LoadAvx2(vy)), lanes);
+			StoreAvx2(vf, zero, lanes);
+			StoreAvx2(vf, one, _mm256_and_si256(lanes, CarryAvx2(LoadAvx2(vx), LoadAvx2(vy))));
+			break;
+		case OP_8XY5:
+			StoreAvx2(vx, _mm256_sub_epi8(LoadAvx2(vx), LoadAvx2(vy)), lanes);
+			StoreAvx2(vf, one, lanes);
+			StoreAvx2(vf, zero, _mm256_and_si256(lanes, CarryAvx2(LoadAvx2(vx), LoadAvx2(vy))));
+			break;
+		case OP_8XY6:
+			StoreAvx2(vf, _mm256_and_si256(LoadAvx2(vx), one), lanes);
+			StoreAvx2(vx, _mm256_and_si256(_mm256_srli_epi16(LoadAvx2(vx), 1), _mm256_set1_epi8(0x7F)), lanes);
+			break;
+		case OP_8XY7:
+		{
+			StoreAvx2(vx, _mm256_sub_epi8(LoadAvx2(vy), LoadAvx2(vx)), lanes);
+			StoreAvx2(vf, one, lanes);
+			__m256i y = LoadAvx2(vy);
+			__m256i below = _mm256_xor_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(y, LoadAvx2(vx)), y), _mm256_set1_epi8(-1));
+			StoreAvx2(vf, zero, _mm256_and_si256(lanes, below));
+		}
+			break;
+		case OP_8XYE:
+			StoreAvx2(vf, _mm256_and_si256(_mm256_srli_epi16(LoadAvx2(vx), 7), one), lanes);
+			StoreAvx2(vx, _mm256_add_epi8(LoadAvx2(vx), LoadAvx2(vx)), lanes);
+			break;
+		case OP_FX07:
+			StoreAvx2(vx, LoadAvx2(delay), lanes);
+			break;
+		case OP_FX15:
+			StoreAvx2(delay, LoadAvx2(vx), lanes);
+			break;
+		case OP_FX18:
+			StoreAvx2(sound, LoadAvx2(vx), lanes);
+			break;
+		default:
+			break;
+	}
+	return (U32)_mm256_movemask_epi8(taken) & mask;
+}
+
+#endif
+
+BatchSuperChip::BatchSuperChip(int lanes) {
+	m_Lanes = lanes;
+	m_Stride = (lanes + BLOCK - 1) / BLOCK * BLOCK;
+	m_Path = BATCH_SCALAR;
+	SetPath(BATCH_AVX2);
+
+	m_Reg.assign(16 * m_Stride, 0);
+	m_RegI.assign(m_Stride, 0);
+	m_RegPC.assign(m_Stride, 0);
+	m_RPLUserFlags.assign(8 * m_Stride, 0);
+	m_TimerDelay.assign(m_Stride, 0);
+	m_TimerSound.assign(m_Stride, 0);
+	m_Key.assign(m_Stride, 0);
+	m_Stack.assign(16 * m_Stride, 0);
+	m_StackPointer.assign(m_Stride, 0);
+	m_Extended.assign(m_Stride, 0);
+	m_Random.assign(m_Stride, 0);
+	m_Plane.assign((size_t)m_Stride * PLANE_SIZE, 0);
+	m_DirtyRows.assign(m_Stride, 0);
+	m_Exited.assign(m_Stride, 1);
+	m_Pages.assign(m_Stride * PAGES, (U32)SHARED);
+	m_PrivatePages.assign(m_Stride, 0);
+	m_Differs.assign((size_t)m_Stride / BLOCK * 4096, 0);
+	m_Active.assign(m_Stride / BLOCK, 0);
+	m_VectorInstructions = 0;
+	m_ScalarInstructions = 0;
+	m_IdleInstructions = 0;
+
+	//Every lane starts from a SuperChip without a rom until one is loaded
+	SuperChip core;
+	SuperChip::State state;
+	core.SaveState(state);
+	Load(state);
+}
+
+void BatchSuperChip::SetPath(BatchPath path) {
+#if defined(BATCH_SIMD_ENABLED)
+	BatchPath best = CpuHasAvx2() ? BATCH_AVX2 : BATCH_SSE2;
+#else
+	BatchPath best = BATCH_SCALAR;
+#endif
+	m_Path = path <= best ? path : best;
+}
+
+void BatchSuperChip::LoadRom(std::string filePath) {
+	SuperChip core;
+	core.LoadRom(filePath);
+	SuperChip::State state;
+	core.SaveState(state);
+	Load(state);
+	for (int lane = 0; lane < m_Lanes; lane++) {
+		m_Random[lane] = (U32)rand();
+	}
+}
+
+void BatchSuperChip::Load(const SuperChip::State& state) {
+	m_Initial = state;
+	memcpy(m_Image, state.m_Memory, sizeof(m_Image));
+	for (int address = 0; address < DECODED_SLOTS; address++) {
+		m_Decoded[address] = DecodeOpCode((m_Image[address] << 8) | m_Image[(address + 1) & 0xFFF], true);
+	}
+	m_PrivateStore.clear();
+	m_FreePages.clear();
+	m_Pages.assign(m_Stride * PAGES, (U32)SHARED);
+	m_PrivatePages.assign(m_Stride, 0);
+	m_Differs.assign(m_Differs.size(), 0);
+	for (int lane = 0; lane < m_Lanes; lane++) {
+		LoadLane(lane, state);
+	}
+}
+
+void BatchSuperChip::ResetLane(int lane) {
+	U32 seed = m_Random[lane];
+	LoadLane(lane, m_Initial);
+	m_Random[lane] = seed;
+}
+
+void BatchSuperChip::LoadLane(int lane, const SuperChip::State& state) {
+	for (int x = 0; x < 16; x++) {
+		m_Reg[x * m_Stride + lane] = state.m_Reg[x];
+		m_Stack[x * m_Stride + lane] = state.m_Stack[x];
+	}
+	for (int i = 0; i < 8; i++) {
+		m_RPLUserFlags[i * m_Stride + lane] = state.m_RPLUserFlags[i];
+	}
+	m_RegI[lane] = state.m_RegI;
+	m_RegPC[lane] = state.m_RegPC & 0xFFF;
+	m_TimerDelay[lane] = state.m_TimerDelay;
+	m_TimerSound[lane] = state.m_TimerSound;
+	m_Key[lane] = state.m_Key;
+	m_StackPointer[lane] = state.m_StackPointer;
+	m_Extended[lane] = state.m_Extended ? 1 : 0;
+	m_Random[lane] = state.m_Random;
+	memcpy(&m_Plane[lane * PLANE_SIZE], state.m_Plane, sizeof(state.m_Plane));
+	m_DirtyRows[lane] = state.m_DirtyRows;
+	m_Exited[lane] = 0;
+	m_Active[lane / BLOCK] |= (U32)1 << (lane % BLOCK);
+
+	//Pages that differ from the image become private, the rest is shared again
+	ReleasePages(lane);
+	for (int page = 0; page < PAGES; page++) {
+		int start = page * PAGE_SIZE;
+		if (memcmp(state.m_Memory + start, m_Image + start, PAGE_SIZE) == 0)
+			continue;
+		for (int address = start; address < start + PAGE_SIZE; address++) {
+			WriteMemory(lane, (U16)address, state.m_Memory[address]);
+		}
+	}
+}
+
+void BatchSuperChip::SaveLane(int lane, SuperChip::State& state) const {
+	for (int address = 0; address < 4096; address++) {
+		state.m_Memory[address] = ReadMemory(lane, (U16)address);
+	}
+	for (int x = 0; x < 16; x++) {
+		state.m_Reg[x] = m_Reg[x * m_Stride + lane];
+		state.m_Stack[x] = m_Stack[x * m_Stride + lane];
+	}
+	for (int i = 0; i < 8; i++) {
+		state.m_RPLUserFlags[i] = m_RPLUserFlags[i * m_Stride + lane];
+	}
+	state.m_RegI = m_RegI[lane];
+	state.m_RegPC = m_RegPC[lane];
+	state.m_TimerDelay = m_TimerDelay[lane];
+	state.m_TimerSound = m_TimerSound[lane];
+	state.m_Key = m_Key[lane];
+	state.m_StackPointer = m_StackPointer[lane];
+	state.m_DoRedraw = false;
+	state.m_DirtyRows = m_DirtyRows[lane];
+	state.m_Extended = m_Extended[lane] != 0;
+	state.m_Random = m_Random[lane];
+	memcpy(state.m_Plane, &m_Plane[lane * PLANE_SIZE], sizeof(state.m_Plane));
+}
+
+U8 BatchSuperChip::ReadMemory(int lane, U16 address) const {
+	address &= 0xFFF;
+	U32 page = m_Pages[lane * PAGES + (address >> PAGE_BITS)];
+	return page == SHARED ? m_Image[address] : m_PrivateStore[page + (address & (PAGE_SIZE - 1))];
+}
+
+void BatchSuperChip::WriteMemory(int lane, U16 address, U8 value) {
+	address &= 0xFFF;
+	U32 page = m_Pages[lane * PAGES + (address >> PAGE_BITS)];
+	if (page == SHARED)
+		page = CopyPage(lane, address >> PAGE_BITS);
+	m_PrivateStore[page + (address & (PAGE_SIZE - 1))] = value;
+
+	U32& differs = m_Differs[lane / BLOCK * 4096 + address];
+	U32 bit = (U32)1 << (lane % BLOCK);
+	differs = value != m_Image[address] ? differs | bit : differs & ~bit;
+}
+
+U32 BatchSuperChip::CopyPage(int lane, int page) {
+	U32 offset;
+	if (!m_FreePages.empty()) {
+		offset = m_FreePages.back();
+		m_FreePages.pop_back();
+	} else {
+		offset = (U32)m_PrivateStore.size();
+		m_PrivateStore.resize(offset + PAGE_SIZE);
+	}
+	memcpy(&m_PrivateStore[offset], m_Image + page * PAGE_SIZE, PAGE_SIZE);
+	m_Pages[lane * PAGES + page] = offset;
+	m_PrivatePages[lane] |= (U16)(1 << page);
+	return offset;
+}
+
+void BatchSuperChip::ReleasePages(int lane) {
+	for (int page = 0; page < PAGES; page++) {
+		U32& offset = m_Pages[lane * PAGES + page];
+		if (offset != SHARED) {
+			m_FreePages.push_back(offset);
+			offset = SHARED;
+			U32* differs = &m_Differs[lane / BLOCK * 4096 + page * PAGE_SIZE];
+			for (int i = 0; i < PAGE_SIZE; i++) {
+				differs[i] &= ~((U32)1 << (lane % BLOCK));
+			}
+		}
+	}
+	m_PrivatePages[lane] = 0;
+}
+
+void BatchSuperChip::Exit(int lane) {
+	m_Exited[lane] = 1;
+	m_Active[lane / BLOCK] &= ~((U32)1 << (lane % BLOCK));
+}
+
+U32 BatchSuperChip::NextRandom(int lane) {
+	m_Random[lane] = m_Random[lane] * 1103515245 + 12345;
+	return (m_Random[lane] >> 16) & 0x7FFF;
+}
+
+void BatchSuperChip::Run(int cycles) {
+	//Budgets are words below 0x8000, longer runs go in several batches
+	while (cycles > 0) {
+		int batch = cycles < MAX_BATCH ? cycles : MAX_BATCH;
+		//A block runs its whole batch while its registers are in the cache
+		for (int block = 0; block < m_Stride / BLOCK; block++) {
+			RunBlock(block, batch);
+		}
+		cycles -= batch;
+	}
+}
+
+void BatchSuperChip::DecreaseTimers() {
+	int i = 0;
+#if defined(BATCH_SIMD_ENABLED)
+	if (m_Path != BATCH_SCALAR) {
+		const __m128i one = _mm_set1_epi8(1);
+		for (; i + 16 <= m_Stride; i += 16) {
+			__m128i* delay = reinterpret_cast<__m128i*>(&m_TimerDelay[i]);
+			__m128i* sound = reinterpret_cast<__m128i*>(&m_TimerSound[i]);
+			_mm_storeu_si128(delay, _mm_subs_epu8(_mm_loadu_si128(delay), one));
+			_mm_storeu_si128(sound, _mm_subs_epu8(_mm_loadu_si128(sound), one));
+		}
+	}
+#endif
+	for (; i < m_Stride; i++) {
+		if (m_TimerDelay[i] > 0)
+			--m_TimerDelay[i];
+		if (m_TimerSound[i] > 0)
+			--m_TimerSound[i];
+	}
+}
+
+void BatchSuperChip::RunBlock(int block, int cycles) {
+	int base = block * BLOCK;
+	U16 remaining[BLOCK];
+	for (int i = 0; i < BLOCK; i++) {
+		remaining[i] = (U16)cycles;
+	}
+
+	//The lanes at the lowest pc go first. A lane that fell behind in a loop catches up with the others instead of
+	//running it a step apart from them, and lanes that branched different ways meet again where the ways join.
+	U32 running = m_Active[block];
+	while (running != 0) {
+		U16 pc = MinWord(&m_RegPC[base], running);
+		running = RunGroup(block, MatchWords(&m_RegPC[base], pc) & running, running, pc, remaining);
+	}
+}
+
+U32 BatchSuperChip::RunGroup(int block, U32 group, U32 running, U16 pc, U16* remaining) {
+	int base = block * BLOCK;
+	U8* reg = &m_Reg[base];
+	U16* pcs = &m_RegPC[base];
+	const U32* differs = &m_Differs[block * 4096];
+	int budget = MinWord(remaining, group);
+	//Instructions every lane in the group ran since it last changed
+	int n = 0;
+	//The other lanes that still run stand at higher pcs. The group takes them in when it gets to their pc and gives way
+	//to them once it is past it.
+	U32 waiting = running & ~group;
+	U16 waitPc = waiting != 0 ? MinWord(pcs, waiting) : 0x7FFF;
+
+	//Lanes that leave the group keep the pc they got to and pay for the instructions they ran
+	auto leave = [&](U32 lanes, U16 lanePc) {
+		StoreWords(pcs, lanes, lanePc);
+		AddWords(remaining, lanes, (U16)-n);
+		group &= ~lanes;
+		lanes &= ~MatchWords(remaining, 0);
+		waiting |= lanes;
+		if (lanes != 0 && lanePc < waitPc)
+			waitPc = lanePc;
+	};
+
+	while (group != 0 && n < budget) {
+		if (pc >= waitPc) {
+			if (pc != waitPc)
+				break;
+			AddWords(remaining, group, (U16)-n);
+			n = 0;
+			U32 joining = MatchWords(pcs, pc) & waiting;
+			group |= joining;
+			waiting &= ~joining;
+			budget = MinWord(remaining, group);
+			waitPc = waiting != 0 ? MinWord(pcs, waiting) : 0x7FFF;
+		}
+
+		const DecodedOp* op = &m_Decoded[pc];
+		DecodedOp own;
+		//Lanes whose copy of the instruction differs from the image run it on their own
+		U32 changed = group & (differs[pc] | differs[(pc + 1) & 0xFFF]);
+		if (changed != 0) {
+			if (n != 0) {
+				leave(changed, pc);
+				if (group == 0)
+					break;
+			} else {
+				U32 lane = changed & (0 - changed);
+				leave(group & ~lane, pc);
+				own = DecodeOpCode((ReadMemory(base + LowestBit(lane), pc) << 8) | ReadMemory(base + LowestBit(lane), pc + 1), true);
+				op = &own;
+			}
+		}
+
+		if ((group & (group - 1)) != 0)
+			m_VectorInstructions += CountBits(group);
+		else
+			m_ScalarInstructions++;
+		n++;
+		U16 next = (pc + 2) & 0xFFF;
+
+		switch (op->handler) {
+			case OP_6XNN:
+			case OP_7XNN:
+			case OP_8XY0:
+			case OP_8XY1:
+			case OP_8XY2:
+			case OP_8XY3:
+			case OP_8XY4:
+			case OP_8XY5:
+			case OP_8XY6:
+			case OP_8XY7:
+			case OP_8XYE:
+			case OP_FX07:
+			case OP_FX15:
+			case OP_FX18:
+				GroupOp(block, group, *op);
+				pc = next;
+				break;
+			case OP_ANNN:
+				StoreWords(&m_RegI[base], group, op->nnn);
+				pc = next;
+				break;
+			case OP_3XNN:
+			case OP_4XNN:
+			case OP_5XY0:
+			case OP_9XY0:
+			case OP_EX9E:
+			case OP_EXA1:
+			{
+				U32 skip = GroupOp(block, group, *op);
+				if (skip == group) {
+					pc = (pc + 4) & 0xFFF;
+				} else {
+					//The lanes that skip go their own way
+					if (skip != 0)
+						leave(skip, (pc + 4) & 0xFFF);
+					pc = next;
+				}
+			}
+				break;
+			case OP_1NNN:
+				//A delay timer spin would go on until the end of the batch, the lanes on one skip it like
+				//SuperChip::RunUntil and stop there
+				if (op->nnn + 4 == pc) {
+					U32 spinning = SpinningLanes(block, group, op->nnn);
+					for (U32 lanes = spinning; lanes != 0; lanes &= lanes - 1) {
+						int i = LowestBit(lanes);
+						int skipped = remaining[i] - n;
+						if (skipped > 0)
+							reg[(ReadMemory(base + i, op->nnn) & 0x0F) * m_Stride + i] = m_TimerDelay[base + i];
+						pcs[i] = (op->nnn + 2 * (skipped % 3)) & 0xFFF;
+						m_IdleInstructions += skipped;
+					}
+					group &= ~spinning;
+					running &= ~spinning;
+				}
+				pc = op->nnn;
+				break;
+			case OP_2NNN:
+				for (U32 lanes = group; lanes != 0; lanes &= lanes - 1) {
+					int lane = base + LowestBit(lanes);
+					m_Stack[(m_StackPointer[lane]++ & 0xF) * m_Stride + lane] = next;
+				}
+				pc = op->nnn;
+				break;
+			case OP_00EE:
+			case OP_BNNN:
+			{
+				//Each lane returns or jumps to an address of its own, the group goes on when they are all the same
+				bool same = true;
+				U16 target = 0;
+				for (U32 lanes = group; lanes != 0; lanes &= lanes - 1) {
+					int i = LowestBit(lanes);
+					int lane = base + i;
+					U16 to;
+					if (op->handler == OP_00EE)
+						to = m_Stack[(--m_StackPointer[lane] & 0xF) * m_Stride + lane] & 0xFFF;
+					else
+						to = (op->nnn + reg[i]) & 0xFFF;
+					pcs[i] = to;
+					if (lanes == group)
+						target = to;
+					else if (to != target)
+						same = false;
+				}
+				if (same) {
+					pc = target;
+				} else {
+					AddWords(remaining, group, (U16)-n);
+					group = 0;
+				}
+			}
+				break;
+			case OP_00FD:
+				for (U32 lanes = group; lanes != 0; lanes &= lanes - 1) {
+					Exit(base + LowestBit(lanes));
+				}
+				StoreWords(pcs, group, next);
+				running &= ~group;
+				group = 0;
+				break;
+			case OP_FX0A:
+			{
+				//Lanes without a key down wait here for the rest of the batch
+				U32 waiting = 0;
+				for (U32 lanes = group; lanes != 0; lanes &= lanes - 1) {
+					int i = LowestBit(lanes);
+					U16 keys = m_Key[base + i];
+					if (keys == 0) {
+						waiting |= (U32)1 << i;
+						m_IdleInstructions += remaining[i] - n;
+					} else {
+						reg[op->x * m_Stride + i] = (U8)LowestBit(keys);
+					}
+				}
+				StoreWords(pcs, waiting, pc);
+				group &= ~waiting;
+				running &= ~waiting;
+				pc = next;
+			}
+				break;
+			default:
+				for (U32 lanes = group; lanes != 0; lanes &= lanes - 1) {
+					ExecuteLane(base + LowestBit(lanes), *op);
+				}
+				pc = next;
+				break;
+		}
+	}
+
+	StoreWords(pcs, group, pc);
+	AddWords(remaining, group, (U16)-n);
+	//Lanes that ran their whole budget are done with this batch
+	return running & ~MatchWords(remaining, 0);
+}
+
+U32 BatchSuperChip::GroupOp(int block, U32 group, const DecodedOp& op) {
+	int base = block * BLOCK;
+	if (op.handler == OP_EX9E || op.handler == OP_EXA1) {
+		//Every lane has keys of its own
+		U32 pressed = 0;
+		for (U32 lanes = group; lanes != 0; lanes &= lanes - 1) {
+			int i = LowestBit(lanes);
+			U8 vx = m_Reg[op.x * m_Stride + base + i];
+			if (vx < 16 && ((m_Key[base + i] >> vx) & 1) != 0)
+				pressed |= (U32)1 << i;
+		}
+		return op.handler == OP_EX9E ? pressed : group & ~pressed;
+	}
+
+	U8* reg = &m_Reg[base];
+	U8* delay = &m_TimerDelay[base];
+	U8* sound = &m_TimerSound[base];
+#if defined(BATCH_SIMD_ENABLED)
+	if (m_Path == BATCH_AVX2)
+		return GroupOpAvx2(op, reg, m_Stride, delay, sound, group);
+	if (m_Path == BATCH_SSE2)
+		return GroupOpSse2(op, reg, m_Stride, delay, sound, group);
+#endif
+	return GroupOpScalar(op, reg, m_Stride, delay, sound, group);
+}
+
+U32 BatchSuperChip::SpinningLanes(int block, U32 group, U16 target) const {
+	//The same bounds as IsDelaySpin
+	if (target + 5 >= 4096)
+		return 0;
+	int base = block * BLOCK;
+	U32 spinning = 0;
+	for (U32 lanes = group; lanes != 0; lanes &= lanes - 1) {
+		int i = LowestBit(lanes);
+		int lane = base + i;
+		if (m_TimerDelay[lane] == 0)
+			continue;
+		U8 first = ReadMemory(lane, target);
+		if ((first & 0xF0) == 0xF0 && ReadMemory(lane, target + 1) == 0x07 &&
+			ReadMemory(lane, target + 2) == (0x30 | (first & 0x0F)) && ReadMemory(lane, target + 3) == 0x00)
+			spinning |= (U32)1 << i;
+	}
+	return spinning;
+}
+
+void BatchSuperChip::StoreWords(U16* words, U32 mask, U16 value) const {
+#if defined(BATCH_SIMD_ENABLED)
+	if (m_Path != BATCH_SCALAR) {
+		StoreWordsSse2(words, mask, value);
+		return;
+	}
+#endif
+	StoreWordsScalar(words, mask, value);
+}
+
+void BatchSuperChip::AddWords(U16* words, U32 mask, U16 value) const {
+#if defined(BATCH_SIMD_ENABLED)
+	if (m_Path != BATCH_SCALAR) {
+		AddWordsSse2(words, mask, value);
+		return;
+	}
+#endif
+	AddWordsScalar(words, mask, value);
+}
+
+U16 BatchSuperChip::MinWord(const U16* words, U32 mask) const {
+#if defined(BATCH_SIMD_ENABLED)
+	if (m_Path != BATCH_SCALAR)
+		return MinWordSse2(words, mask);
+#endif
+	return MinWordScalar(words, mask);
+}
+
+U32 BatchSuperChip::MatchWords(const U16* words, U16 value) const {
+#if defined(BATCH_SIMD_ENABLED)
+	if (m_Path != BATCH_SCALAR)
+		return MatchWordsSse2(words, value);
+#endif
+	return MatchWordsScalar(words, value);
+}
+
+void BatchSuperChip::ExecuteLane(int lane, const DecodedOp& op) {
+	U8* reg = &m_Reg[lane];
+	const int stride = m_Stride;
+	U8& vx = reg[op.x * stride];
+	U8& vy = reg[op.y * stride];
+	U8& vf = reg[0xF * stride];
+	U16& regI = m_RegI[lane];
+	U64* plane = &m_Plane[lane * PLANE_SIZE];
+	U64& dirtyRows = m_DirtyRows[lane];
+	bool extended = m_Extended[lane] != 0;
+
+	switch (op.handler) {
+		case OP_00CN:
+			if (extended)
+				ScrollPlaneDown(plane, PLANE_WORDS, SuperChipPolicy::HIRES_WIDTH / 64, SuperChipPolicy::HIRES_HEIGHT, op.n);
+			else
+				ScrollPlaneDown(plane, PLANE_WORDS, SuperChipPolicy::WIDTH / 64, SuperChipPolicy::HEIGHT, op.n);
+			if (op.n != 0)
+				dirtyRows |= SuperChip::RowMask(Height(lane));
+			break;
+		case OP_00E0:
+			memset(plane, 0, PLANE_SIZE * sizeof(U64));
+			dirtyRows = ~(U64)0;
+			break;
+		case OP_00FB:
+			if (extended)
+				ScrollPlaneRight4(plane, PLANE_WORDS, SuperChipPolicy::HIRES_WIDTH / 64, SuperChipPolicy::HIRES_HEIGHT);
+			else
+				ScrollPlaneRight4(plane, PLANE_WORDS, SuperChipPolicy::WIDTH / 64, SuperChipPolicy::HEIGHT);
+			dirtyRows |= SuperChip::RowMask(Height(lane));
+			break;
+		case OP_00FC:
+			if (extended)
+				ScrollPlaneLeft4(plane, PLANE_WORDS, SuperChipPolicy::HIRES_WIDTH / 64, SuperChipPolicy::HIRES_HEIGHT);
+			else
+				ScrollPlaneLeft4(plane, PLANE_WORDS, SuperChipPolicy::WIDTH / 64, SuperChipPolicy::HEIGHT);
+			dirtyRows |= SuperChip::RowMask(Height(lane));
+			break;
+		case OP_00FE:
+			m_Extended[lane] = 0;
+			dirtyRows = ~(U64)0;
+			break;
+		case OP_00FF:
+			m_Extended[lane] = 1;
+			dirtyRows = ~(U64)0;
+			break;
+		case OP_CXNN:
+			vx = (NextRandom(lane) % 0xFF) & op.nn;
+			break;
+		case OP_DXYN:
+			if (extended) {
+				if (op.n == 0)
+					vf = DrawSprite<SuperChipPolicy::HIRES_WIDTH, SuperChipPolicy::HIRES_HEIGHT>(lane, vx, vy, 16, 2, regI);
+				else
+					vf = DrawSprite<SuperChipPolicy::HIRES_WIDTH, SuperChipPolicy::HIRES_HEIGHT>(lane, vx, vy, op.n, 1, regI);
+			} else {
+				vf = DrawSprite<SuperChipPolicy::WIDTH, SuperChipPolicy::HEIGHT>(lane, vx, vy, op.n, 1, regI);
+			}
+			break;
+		case OP_FX1E:
+			regI += vx;
+			vf = regI > 0xFFF ? 1 : 0;
+			break;
+		case OP_FX29:
+			regI = vx * 5;
+			break;
+		case OP_FX30:
+			regI = vx * 10 + SuperChip::SUPERFONT_START;
+			break;
+		case OP_FX33:
+		{
+			U8 number = vx;
+			WriteMemory(lane, regI, number / 100);
+			WriteMemory(lane, regI + 1, number / 10 % 10);
+			WriteMemory(lane, regI + 2, number % 10);
+		}
+			break;
+		case OP_FX55:
+			for (int i = 0; i <= op.x; i++) {
+				WriteMemory(lane, regI + i, reg[i * stride]);
+			}
+			regI += op.x + 1;
+			break;
+		case OP_FX65:
+			for (int i = 0; i <= op.x; i++) {
+				reg[i * stride] = ReadMemory(lane, regI + i);
+			}
+			regI += op.x + 1;
+			break;
+		case OP_FX75:
+			//Stores V0 to VX - 1 like the interpreter
+			for (int i = 0; i < (op.x > 7 ? 7 : op.x); i++) {
+				m_RPLUserFlags[i * stride + lane] = reg[i * stride];
+			}
+			break;
+		case OP_FX85:
+			for (int i = 0; i <= (op.x > 7 ? 7 : op.x); i++) {
+				reg[i * stride] = m_RPLUserFlags[i * stride + lane];
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+template <int W, int H>
+bool BatchSuperChip::DrawSprite(int lane, U8 xInit, U8 yInit, int rows, int bytesPerRow, U16 address) {
+	static const int WORDS = W / 64;
+	U64 collision = 0;
+	U64* plane = &m_Plane[lane * PLANE_SIZE];
+
+	//Sprites wrap around the display edges on SuperChip, see Chip8Core::DrawSprite
+	int word = (xInit % W) / 64;
+	int shift = xInit % 64;
+	int spillWord = word + 1 < WORDS ? word + 1 : 0;
+	//Rows straight from the image unless the lane has a page of its own
+	const U8* image = m_PrivatePages[lane] == 0 && address + rows * bytesPerRow <= 4096 ? m_Image + address : nullptr;
+
+	for (int y = 0; y < rows; y++) {
+		U64 bits;
+		if (image != nullptr && bytesPerRow == 2)
+			bits = (U64)((image[y * 2] << 8) | image[y * 2 + 1]) << 48;
+		else if (image != nullptr)
+			bits = (U64)image[y] << 56;
+		else if (bytesPerRow == 2)
+			bits = (U64)((ReadMemory(lane, address + y * 2) << 8) | ReadMemory(lane, address + y * 2 + 1)) << 48;
+		else
+			bits = (U64)ReadMemory(lane, address + y) << 56;
+
+		if (bits == 0)
+			continue;
+
+		int rowIndex = (yInit + y) % H;
+		m_DirtyRows[lane] |= (U64)1 << rowIndex;
+		U64* row = plane + rowIndex * PLANE_WORDS;
+		U64 first = bits >> shift;
+		collision |= row[word] & first;
+		row[word] ^= first;
+
+		if (shift != 0) {
+			U64 spill = bits << (64 - shift);
+			collision |= row[spillWord] & spill;
+			row[spillWord] ^= spill;
+		}
+	}
+
+	return collision != 0;
+}
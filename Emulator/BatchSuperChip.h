@@ -0,0 +1,144 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "OpCode.h"
+#include "SuperChip.h"
+
+enum BatchPath : U8 {
+	BATCH_SCALAR,
+	BATCH_SSE2,
+	BATCH_AVX2
+};
+
+//Runs many copies of one SuperChip rom side by side, for training agents on thousands of input streams at once. Each
+//lane has its own registers, keys, timers, display and memory, stored as structure of arrays: register X of lane l is
+//m_Reg[X * m_Stride + l], so the same register of neighbouring lanes is contiguous.
+//
+//Lanes run in blocks of BLOCK lanes, a whole batch of instructions per block before the next one. The lanes of a block
+//that share the lowest pc form a group and run on together, one decoded instruction at a time for all of them, until
+//a branch splits them up: register, timer and skip instructions execute for the whole group at once with SSE2 or AVX2,
+//jumps, calls and returns move the group as one, and draws and the other instructions loop over its lanes. Each lane
+//has a budget of instructions per batch, so lanes that split up keep their count and meet again at a later pc.
+//
+//Like SuperChip::RunUntil, a lane that reaches a delay timer spin or waits in FX0A without a key skips the rest of its
+//batch, so a block whose lanes all wait is done early.
+//
+//Memory is the rom image shared by all lanes, in pages of PAGE_SIZE bytes. The first write of a lane to a page gives it
+//a private copy of that page. A lane whose copy changed the instruction at its pc runs it on its own.
+//
+//A lane runs like SuperChip::RunCycles with the same keys and timers, except that it stops for good at 00FD. Addresses
+//past the 4 KB of memory wrap around instead of reaching past it.
+struct BatchSuperChip {
+	//Lanes per block, one AVX2 register of 8 bit registers
+	static const int BLOCK = 32;
+	static const int PAGE_BITS = 8;
+	static const int PAGE_SIZE = 1 << PAGE_BITS;
+	static const int PAGES = 4096 / PAGE_SIZE;
+	static const int PLANE_WORDS = SuperChip::PLANE_WORDS;
+	static const int PLANE_SIZE = PLANE_WORDS * SuperChip::MAX_HEIGHT;
+	//m_Pages entry of a page the lane shares with the image
+	static const U32 SHARED = 0xFFFFFFFF;
+	//Longest batch, budgets are words below 0x8000
+	static const int MAX_BATCH = 0x7FFF;
+
+	int m_Lanes;
+	//Lanes rounded up to whole blocks, the distance between the registers of two lanes
+	int m_Stride;
+	BatchPath m_Path;
+
+	//Per lane, indexed by lane or by register * m_Stride + lane
+	std::vector<U8> m_Reg;
+	std::vector<U16> m_RegI;
+	std::vector<U16> m_RegPC;
+	std::vector<U8> m_RPLUserFlags;
+	std::vector<U8> m_TimerDelay;
+	std::vector<U8> m_TimerSound;
+	std::vector<U16> m_Key;
+	std::vector<U16> m_Stack;
+	std::vector<U8> m_StackPointer;
+	std::vector<U8> m_Extended;
+	std::vector<U32> m_Random;
+	//PLANE_SIZE words per lane, laid out like SuperChip::m_Plane
+	std::vector<U64> m_Plane;
+	std::vector<U64> m_DirtyRows;
+	std::vector<U8> m_Exited;
+
+	//The rom image and its instructions, decoded once for every lane
+	U8 m_Image[4096];
+	DecodedOp m_Decoded[DECODED_SLOTS];
+	//State LoadRom or Load started the lanes from, for ResetLane
+	SuperChip::State m_Initial;
+
+	//Copy-on-write pages: PAGES entries per lane, SHARED or the offset of the lane's copy in m_PrivateStore
+	std::vector<U32> m_Pages;
+	std::vector<U8> m_PrivateStore;
+	std::vector<U32> m_FreePages;
+	//Bit p for each private page of a lane
+	std::vector<U16> m_PrivatePages;
+	//Per block and address the lanes whose memory differs from the image there, bit i of m_Differs[block * 4096 +
+	//address] for lane block * BLOCK + i
+	std::vector<U32> m_Differs;
+	//Per block the lanes that still run, bit i for lane block * BLOCK + i
+	std::vector<U32> m_Active;
+
+	//Lane instructions run in groups and lane by lane, to see how well the lanes stay together, and the ones idle lanes
+	//skipped
+	U64 m_VectorInstructions;
+	U64 m_ScalarInstructions;
+	U64 m_IdleInstructions;
+
+	BatchSuperChip(int lanes);
+
+	int Lanes() const { return m_Lanes; }
+	//Fastest path the CPU supports unless set, a path the CPU does not support is replaced with the best one
+	void SetPath(BatchPath path);
+	BatchPath Path() const { return m_Path; }
+
+	//Starts every lane from the rom, each with its own seed for CXNN from rand()
+	void LoadRom(std::string filePath);
+	//Starts every lane from state, sharing its memory as the image
+	void Load(const SuperChip::State& state);
+	//Starts a lane over from the state LoadRom or Load started it from
+	void ResetLane(int lane);
+	void SetRandomSeed(int lane, U32 seed) { m_Random[lane] = seed; }
+
+	//Runs cycles instructions on every lane that did not exit
+	void Run(int cycles);
+	void DecreaseTimers();
+
+	//A single lane as a SuperChip state, for rendering, snapshots and comparing with a SuperChip
+	void SaveLane(int lane, SuperChip::State& state) const;
+	void LoadLane(int lane, const SuperChip::State& state);
+
+	void SetKeys(int lane, U16 keys) { m_Key[lane] = keys; }
+	U8 Reg(int lane, int x) const { return m_Reg[x * m_Stride + lane]; }
+	bool Exited(int lane) const { return m_Exited[lane] != 0; }
+	U8 ReadMemory(int lane, U16 address) const;
+	const U64* Plane(int lane) const { return &m_Plane[lane * PLANE_SIZE]; }
+	int Width(int lane) const { return m_Extended[lane] ? SuperChipPolicy::HIRES_WIDTH : SuperChipPolicy::WIDTH; }
+	int Height(int lane) const { return m_Extended[lane] ? SuperChipPolicy::HIRES_HEIGHT : SuperChipPolicy::HEIGHT; }
+	U64 TakeDirtyRows(int lane) { U64 rows = m_DirtyRows[lane]; m_DirtyRows[lane] = 0; return rows; }
+
+private:
+	void RunBlock(int block, int cycles);
+	//Runs the lanes of group, which all stand at pc, until they split up or one of them is out of budget. Returns the
+	//lanes of running that go on in this batch.
+	U32 RunGroup(int block, U32 group, U32 running, U16 pc, U16* remaining);
+	//Register, timer and skip instructions for a group, returns the lanes that skip
+	U32 GroupOp(int block, U32 group, const DecodedOp& op);
+	//Lanes of group on the jump back to target of a delay timer spin, see IsDelaySpin
+	U32 SpinningLanes(int block, U32 group, U16 target) const;
+	//Instructions that work on the memory or display of a lane, without moving its pc
+	void ExecuteLane(int lane, const DecodedOp& op);
+	void StoreWords(U16* words, U32 mask, U16 value) const;
+	void AddWords(U16* words, U32 mask, U16 value) const;
+	U16 MinWord(const U16* words, U32 mask) const;
+	U32 MatchWords(const U16* words, U16 value) const;
+	U32 NextRandom(int lane);
+	void WriteMemory(int lane, U16 address, U8 value);
+	U32 CopyPage(int lane, int page);
+	void ReleasePages(int lane);
+	void Exit(int lane);
+	template <int W, int H> bool DrawSprite(int lane, U8 xInit, U8 yInit, int rows, int bytesPerRow, U16 address);
+};
@@ -0,0 +1,90 @@
+#include "Beeper.h"
+
+//Raises a maximum that only the audio callback increases, TakeStats may reset it in between
+static void StoreMax(std::atomic<U32>& max, U32 value) {
+	U32 current = max.load(std::memory_order_relaxed);
+	while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+	}
+}
+
+Beeper::Beeper() : m_Played(0), m_Callbacks(0), m_Underruns(0), m_Overruns(0), m_RingLatencySum(0), m_RingLatencyMax(0), m_IntervalSum(0), m_Intervals(0), m_IntervalMax(0) {
+	m_Rendered = 0;
+	m_On = false;
+	m_Phase = 0;
+	m_HasCallback = false;
+}
+
+void Beeper::SetTone(bool on, int instruction, int instructions) {
+	int sample = 0;
+	if (instructions > 0 && instruction > 0)
+		sample = instruction >= instructions ? TICK_SAMPLES : instruction * TICK_SAMPLES / instructions;
+	Render(sample);
+	if (on && !m_On)
+		m_Phase = 0;
+	m_On = on;
+}
+
+bool Beeper::EndTick() {
+	Render(TICK_SAMPLES);
+	m_Rendered = 0;
+	int written = m_Ring.Write(m_Tick, TICK_SAMPLES);
+	if (written < TICK_SAMPLES) {
+		m_Overruns.fetch_add(TICK_SAMPLES - written, std::memory_order_relaxed);
+		return false;
+	}
+	return true;
+}
+
+void Beeper::Render(int end) {
+	if (!m_On) {
+		for (; m_Rendered < end; m_Rendered++)
+			m_Tick[m_Rendered] = 0;
+		return;
+	}
+	//High for the first half of each period
+	for (; m_Rendered < end; m_Rendered++) {
+		m_Tick[m_Rendered] = m_Phase < SAMPLE_RATE / 2 ? AMPLITUDE : -AMPLITUDE;
+		m_Phase += FREQUENCY;
+		if (m_Phase >= SAMPLE_RATE)
+			m_Phase -= SAMPLE_RATE;
+	}
+}
+
+int Beeper::Read(short* samples, int count) {
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	U32 queued = m_Ring.Size();
+	if (m_HasCallback) {
+		U32 interval = (U32)std::chrono::duration_cast<std::chrono::microseconds>(now - m_LastCallback).count();
+		m_IntervalSum.fetch_add(interval, std::memory_order_relaxed);
+		m_Intervals.fetch_add(1, std::memory_order_relaxed);
+		StoreMax(m_IntervalMax, interval);
+	}
+	m_LastCallback = now;
+	m_HasCallback = true;
+	m_RingLatencySum.fetch_add(queued, std::memory_order_relaxed);
+	StoreMax(m_RingLatencyMax, queued);
+	m_Callbacks.fetch_add(1, std::memory_order_relaxed);
+
+	int read = m_Ring.Read(samples, count);
+	for (int i = read; i < count; i++)
+		samples[i] = 0;
+	if (read < count)
+		m_Underruns.fetch_add(count - read, std::memory_order_relaxed);
+	m_Played.fetch_add(count, std::memory_order_release);
+	return read;
+}
+
+Beeper::Stats Beeper::TakeStats() {
+	Stats stats;
+	stats.callbacks = m_Callbacks.exchange(0, std::memory_order_relaxed);
+	stats.underruns = m_Underruns.exchange(0, std::memory_order_relaxed);
+	stats.overruns = m_Overruns.exchange(0, std::memory_order_relaxed);
+	U64 latencySum = m_RingLatencySum.exchange(0, std::memory_order_relaxed);
+	stats.maxRingLatency = (double)m_RingLatencyMax.exchange(0, std::memory_order_relaxed) / SAMPLE_RATE;
+	U64 intervalSum = m_IntervalSum.exchange(0, std::memory_order_relaxed);
+	U32 intervals = m_Intervals.exchange(0, std::memory_order_relaxed);
+	stats.maxCallbackInterval = m_IntervalMax.exchange(0, std::memory_order_relaxed) * 1e-6;
+	stats.ringLatency = stats.callbacks != 0 ? (double)latencySum / stats.callbacks / SAMPLE_RATE : 0;
+	stats.callbackInterval = intervals != 0 ? intervalSum * 1e-6 / intervals : 0;
+	return stats;
+}
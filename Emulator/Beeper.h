@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+
+#include "OpCode.h"
+#include "SpscQueue.h"
+
+//The CHIP-8 buzzer, a square wave that sounds while the sound timer is not zero. The emulation thread renders each
+//60 Hz tick into samples and queues them in a lock-free ring, the audio callback of the output takes them from there.
+//Within a tick the tone switches at the sample that matches the instruction where FX18 started or stopped it, a tick
+//of n instructions spreads them evenly over its TICK_SAMPLES samples.
+//
+//	beeper.SetTone(emulator.m_TimerSound != 0, 0, instructions);
+//	//for every FX18 that changes the sound, after done instructions
+//	beeper.SetTone(emulator.m_TimerSound != 0, done, instructions);
+//	beeper.EndTick();
+struct Beeper {
+	static const int SAMPLE_RATE = 44100;
+	static const int TICK_RATE = 60;
+	static const int TICK_SAMPLES = SAMPLE_RATE / TICK_RATE;
+	static const int FREQUENCY = 440;
+	static const short AMPLITUDE = 6000;
+	//About 190 ms, far more than the output keeps queued, the rest is room for the emulation thread running ahead
+	static const int RING_SIZE = 8192;
+
+	//Measured at the audio callback since the last TakeStats. Latencies are in seconds.
+	struct Stats {
+		U32 callbacks;
+		//Samples played as silence because the ring ran dry, and samples dropped because it was full
+		U32 underruns;
+		U32 overruns;
+		//Sound queued in the ring when the callback took from it, the time a sample waits before the output has it
+		double ringLatency;
+		double maxRingLatency;
+		//Time between callbacks, the output's own buffering on top of the ring
+		double callbackInterval;
+		double maxCallbackInterval;
+	};
+
+	SpscQueue<short, RING_SIZE> m_Ring;
+
+	//Emulation thread: the tick being rendered
+	short m_Tick[TICK_SAMPLES];
+	int m_Rendered;
+	bool m_On;
+	//Position in the wave in 1/SAMPLE_RATE periods, restarts with each tone
+	U32 m_Phase;
+
+	//Samples the callback took, silence included, the output's clock
+	std::atomic<U32> m_Played;
+
+	//Audio callback
+	std::chrono::steady_clock::time_point m_LastCallback;
+	bool m_HasCallback;
+	std::atomic<U32> m_Callbacks;
+	std::atomic<U32> m_Underruns;
+	std::atomic<U32> m_Overruns;
+	//In samples and microseconds
+	std::atomic<U64> m_RingLatencySum;
+	std::atomic<U32> m_RingLatencyMax;
+	std::atomic<U64> m_IntervalSum;
+	std::atomic<U32> m_Intervals;
+	std::atomic<U32> m_IntervalMax;
+
+	Beeper();
+
+	//Emulation thread: the tone is on or off from instruction of the instructions in this tick on
+	void SetTone(bool on, int instruction, int instructions);
+	//Emulation thread: renders the rest of the tick and queues it, false when the ring was full and samples were dropped
+	bool EndTick();
+	//Emulation thread: samples in the ring
+	U32 Queued() const { return m_Ring.Size(); }
+	//Any thread: samples played since the start, wrapping around
+	U32 Played() const { return m_Played.load(std::memory_order_acquire); }
+
+	//Audio callback: fills samples with the next count samples, silence for those the emulation did not render yet.
+	//Returns how many came from the ring.
+	int Read(short* samples, int count);
+
+	//Any thread: the measurements since the last call
+	Stats TakeStats();
+
+private:
+	void Render(int end);
+};
@@ -1,30 +1,17 @@
-#include <iostream>
-#include <fstream>
-#include <string>
+#pragma once
+#include "Chip8Core.h"
 
-typedef unsigned char U8;
-typedef unsigned short U16;
-typedef unsigned int U32;
+//Original CHIP-8: 64x32 display, no SuperChip opcodes.
+struct Chip8Policy {
+	static const bool SUPER_OPCODES = false;
+	static const int WIDTH = 64;
+	static const int HEIGHT = 32;
+	static const int HIRES_WIDTH = 64;
+	static const int HIRES_HEIGHT = 32;
+	static const bool SHIFT_VY = false;
+	static const bool LOAD_STORE_INCREMENTS_I = true;
+	static const bool JUMP_VX = false;
+	static const bool SPRITE_WRAP = true;
+};
 
-struct Chip8 {
-	U8 m_Memory[4096];
-	U8 m_Reg[16];
-	U16 m_RegI;
-	U16 m_RegPC;
-	U32 m_Texture[64 * 32];
-
-	U8 m_TimerDelay;
-	U8 m_TimerSound;
-
-	U16 m_Key;
-
-	U16 m_Stack[16];
-	U8 m_StackPointer; 
-
-	bool m_DoRedraw;
-
-	Chip8();
-	void LoadRom(std::string filePath);
-	void Loop();
-	void DecreaseTimers();
-};
\ No newline at end of file
+typedef Chip8Core<Chip8Policy> Chip8;
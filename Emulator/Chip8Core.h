@@ -0,0 +1,132 @@
+#pragma once
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <functional>
+#include <type_traits>
+
+#include "OpCode.h"
+
+//Interpreter shared by Chip8 and SuperChip. Policy sets the display size, the enabled opcodes and the quirks:
+//
+//	static const bool SUPER_OPCODES;			00CN, 00FB-00FF, FX30, FX75, FX85 and 16x16 sprites
+//	static const int WIDTH, HEIGHT;				Display size in normal mode
+//	static const int HIRES_WIDTH, HIRES_HEIGHT;	Display size in extended mode, equal to WIDTH and HEIGHT without SUPER_OPCODES
+//	static const bool SHIFT_VY;					8XY6 and 8XYE shift VY into VX instead of shifting VX
+//	static const bool LOAD_STORE_INCREMENTS_I;	FX55 and FX65 leave I pointing past the last register
+//	static const bool JUMP_VX;					BNNN jumps to XNN plus VX instead of NNN plus V0
+//	static const bool SPRITE_WRAP;				Sprites wrap around the display edges instead of being clipped
+//Everything a running rom can change. It is plain data, so saving or restoring a core is a single copy of it, see
+//Chip8Core::SaveState.
+template <class Policy>
+struct Chip8State {
+	static_assert(Policy::HIRES_HEIGHT <= 64, "m_DirtyRows has one bit per display row");
+
+	U8 m_Memory[4096];
+	U8 m_Reg[16];
+	U16 m_RegI;
+	U16 m_RegPC;
+	U8 m_RPLUserFlags[8];
+	//Display, one bit per pixel. Row y starts at m_Plane[y * PLANE_WORDS] and pixel x is bit 63 - x % 64 of word x / 64.
+	U64 m_Plane[Policy::HIRES_WIDTH / 64 * Policy::HIRES_HEIGHT];
+
+	U8 m_TimerDelay;
+	U8 m_TimerSound;
+
+	U16 m_Key;
+
+	U16 m_Stack[16];
+	U8 m_StackPointer;
+
+	bool m_DoRedraw;
+	//Rows of m_Plane changed since the last TakeDirtyRows call, bit y for row y
+	U64 m_DirtyRows = 0;
+	bool m_Extended = false;
+	//CXNN generator, seeded from rand() by LoadRom
+	U32 m_Random = 0;
+};
+
+template <class Policy>
+struct Chip8Core : Chip8State<Policy> {
+	typedef Chip8State<Policy> State;
+	static_assert(std::is_trivially_copyable<State>::value, "Chip8State is copied as plain data");
+
+	//Largest display size, the extended mode size on SuperChip
+	static const int MAX_WIDTH = Policy::HIRES_WIDTH;
+	static const int MAX_HEIGHT = Policy::HIRES_HEIGHT;
+	static const int GFX_SIZE = MAX_WIDTH * MAX_HEIGHT;
+	//64 bit words in a row of the display plane
+	static const int PLANE_WORDS = Policy::HIRES_WIDTH / 64;
+
+	using State::m_Memory;
+	using State::m_Reg;
+	using State::m_RegI;
+	using State::m_RegPC;
+	using State::m_RPLUserFlags;
+	using State::m_Plane;
+	using State::m_TimerDelay;
+	using State::m_TimerSound;
+	using State::m_Key;
+	using State::m_Stack;
+	using State::m_StackPointer;
+	using State::m_DoRedraw;
+	using State::m_DirtyRows;
+	using State::m_Extended;
+	using State::m_Random;
+
+	//Predecoded instruction for every address, cleared when memory under it is written
+	DecodedOp m_Decoded[DECODED_SLOTS];
+
+	std::function<void(void)> m_ExitCallback;
+	std::function<void(U16, U16)> m_CodeWriteCallback;
+
+	Chip8Core();
+	void LoadRom(std::string filePath);
+	void Loop();
+	//Runs cycles instructions, or fewer when the rom exits, and returns the RunEvent flags raised on the way
+	U32 RunCycles(int cycles);
+	//Runs until an instruction raises one of stopEvents or maxCycles instructions have run.
+	//Instructions skipped by an idle wait (EVENT_IDLE) count as executed.
+	U32 RunUntil(U32 stopEvents, int maxCycles, int* executed = nullptr);
+	void DecreaseTimers();
+	void InvalidateDecoded(U16 address, U16 length);
+	//Next CXNN random number, 0 to 0x7FFF
+	U32 NextRandom() {
+		m_Random = m_Random * 1103515245 + 12345;
+		return (m_Random >> 16) & 0x7FFF;
+	}
+
+	//Snapshots for run-ahead and rewinding. Restoring drops the instructions decoded from memory that differs from the
+	//saved state, everything else is copied as it is.
+	void SaveState(State& state) const { state = *this; }
+	void LoadState(const State& state);
+	void TestExit() { m_ExitCallback(); };
+
+	void SetExitCallback(std::function<void(void)> callback) { m_ExitCallback = callback; }
+	//Called with the address and length of every guest write that can change code (FX33, FX55, LoadRom)
+	void SetCodeWriteCallback(std::function<void(U16, U16)> callback) { m_CodeWriteCallback = callback; }
+
+	//Size of the active display, the first Width() pixels of the first Height() rows of m_Plane
+	int Width() const { return Policy::SUPER_OPCODES && m_Extended ? Policy::HIRES_WIDTH : Policy::WIDTH; }
+	int Height() const { return Policy::SUPER_OPCODES && m_Extended ? Policy::HIRES_HEIGHT : Policy::HEIGHT; }
+	//Writes the active display as Width() * Height() RGBA pixels, 0xFFFFFFFF when set and 0x000000FF when clear
+	void ToRGBA(U32* pixels) const { RowsToRGBA(pixels, 0, Height()); }
+	//Writes rowCount rows of the active display starting at firstRow, Width() pixels per row
+	void RowsToRGBA(U32* pixels, int firstRow, int rowCount) const;
+	//Returns the rows changed by 00E0, DXYN, the scrolls and LoadRom since the last call, and clears them
+	U64 TakeDirtyRows() { U64 rows = m_DirtyRows; m_DirtyRows = 0; return rows; }
+	//Dirty row bits of the first rows rows
+	static U64 RowMask(int rows) { return rows >= 64 ? ~(U64)0 : ((U64)1 << rows) - 1; }
+
+private:
+	//Display helpers, instantiated once per display size so that the dimensions are constants
+	template <int W, int H> bool DrawSprite(U8 xInit, U8 yInit, int rows, int bytesPerRow, U16 address);
+	template <int W, int H> void ScrollDown(int lines);
+	template <int W, int H> void ScrollRight();
+	template <int W, int H> void ScrollLeft();
+	//Clears the whole state and stores the fonts
+	void ResetState();
+
+public:
+	static const U16 SUPERFONT_START = 80;
+};
@@ -0,0 +1,644 @@
+#pragma once
+#include "Chip8Core.h"
+#include <cstring>
+#include "Scroll.h"
+
+//Member definitions of Chip8Core, included by the translation units that instantiate it.
+
+using namespace std;
+
+template <class Policy>
+Chip8Core<Policy>::Chip8Core() {
+	ResetState();
+	memset(m_Decoded, 0, sizeof(m_Decoded));
+}
+
+template <class Policy>
+void Chip8Core<Policy>::ResetState() {
+	U8 font[80] = {
+		0xF0, 0x90, 0x90, 0x90, 0xF0,
+		0x20, 0x60, 0x20, 0x20, 0x70,
+		0xF0, 0x10, 0xF0, 0x80, 0xF0,
+		0xF0, 0x10, 0xF0, 0x10, 0xF0,
+
+		0x90, 0x90, 0xF0, 0x10, 0x10,
+		0xF0, 0x80, 0xF0, 0x10, 0xF0,
+		0xF0, 0x80, 0xF0, 0x90, 0xF0,
+		0xF0, 0x10, 0x20, 0x40, 0x40,
+
+		0xF0, 0x90, 0xF0, 0x90, 0xF0,
+		0xF0, 0x90, 0xF0, 0x10, 0xF0,
+		0xF0, 0x90, 0xF0, 0x90, 0x90,
+		0xE0, 0x90, 0xE0, 0x90, 0xE0,
+
+		0xF0, 0x80, 0x80, 0x80, 0xF0,
+		0xE0, 0x90, 0x90, 0x90, 0xE0,
+		0xF0, 0x80, 0xF0, 0x80, 0xF0,
+		0xF0, 0x80, 0xF0, 0x80, 0x80
+	};
+
+	U8 superfont[160] =
+	{
+		0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF,
+		0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF,
+		0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF,
+		0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,
+
+		0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03,
+		0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,
+		0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF,
+		0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18,
+
+		0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF,
+		0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,
+		0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3,
+		0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC,
+
+		0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C,
+		0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC,
+		0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF,
+		0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0,
+	};
+
+	//Everything but the fonts starts out as zero, whatever the memory of the core held before
+	static_cast<State&>(*this) = State();
+	memcpy(m_Memory, font, 80);
+	if (Policy::SUPER_OPCODES) {
+		memcpy(m_Memory + SUPERFONT_START, superfont, 160);
+	}
+}
+
+template <class Policy>
+void Chip8Core<Policy>::LoadRom(std::string filePath) {
+	streampos size;
+	ifstream file;
+	file.open(filePath, ios::in | ios::binary | ios::ate);
+
+	//Nothing of the previous rom is left: memory, registers, stack and flags start from zero like in a new core
+	ResetState();
+	//Forget instructions decoded from the previous rom
+	InvalidateDecoded(0, sizeof(m_Memory));
+
+	if (file.is_open()) {
+		size = file.tellg();
+		file.seekg(0, ios::beg);
+		file.read((char*)m_Memory + 512, size);
+		file.close();
+	} else {
+		cout << "File " << filePath << " not found." << endl;
+	}
+
+	m_RegPC = 0x200;
+	//The cleared screen is redrawn whole
+	m_DirtyRows = ~(U64)0;
+
+	m_Random = (U32)rand();
+}
+
+
+
+template <class Policy>
+void Chip8Core<Policy>::Loop() {
+	RunCycles(1);
+}
+
+template <class Policy>
+U32 Chip8Core<Policy>::RunCycles(int cycles) {
+	return RunUntil(EVENT_EXIT, cycles);
+}
+
+template <class Policy>
+U32 Chip8Core<Policy>::RunUntil(U32 stopEvents, int maxCycles, int* executed) {
+	U32 events = 0;
+	int cycles = 0;
+
+	//Keep the register file in locals for the whole batch
+	U8 reg[16];
+	memcpy(reg, m_Reg, sizeof(reg));
+	U16 pc = m_RegPC;
+	U16 regI = m_RegI;
+
+	while (cycles < maxCycles && (events & stopEvents) == 0) {
+		//Get decoded instruction, decoding it on first execution
+		pc &= DECODED_SLOTS - 1;
+		DecodedOp& slot = m_Decoded[pc];
+		if (slot.handler == OP_UNDECODED) {
+			slot = FuseOpCodes(DecodeOpCode((m_Memory[pc] << 8) | m_Memory[(pc + 1) & 0xFFF], Policy::SUPER_OPCODES),
+				(m_Memory[(pc + 2) & 0xFFF] << 8) | m_Memory[(pc + 3) & 0xFFF],
+				(m_Memory[(pc + 4) & 0xFFF] << 8) | m_Memory[(pc + 5) & 0xFFF]);
+		}
+		DecodedOp op = slot;
+		pc += 2;
+
+		//Run only the first instruction of a fused sequence that does not fit in the batch
+		if (op.handler >= OP_FUSED_FIRST && maxCycles - cycles < FusedLength(op.handler)) {
+			op.handler = UnfusedHandler(op.handler);
+		}
+
+		switch (op.handler) {
+			case OP_00CN:
+				//00CN* - Scroll display N lines down
+				if (m_Extended)
+					ScrollDown<Policy::HIRES_WIDTH, Policy::HIRES_HEIGHT>(op.n);
+				else
+					ScrollDown<Policy::WIDTH, Policy::HEIGHT>(op.n);
+				events |= EVENT_REDRAW;
+				break;
+			case OP_00E0:
+				//00E0 - Clear screen
+				memset(m_Plane, 0, sizeof(m_Plane));
+				m_DirtyRows = ~(U64)0;
+				events |= EVENT_REDRAW;
+				break;
+			case OP_00EE:
+				//00EE - return from subroutine
+				pc = m_Stack[--m_StackPointer];
+				break;
+			case OP_00FB:
+				//00FB* - Scroll display 4 pixels right
+				if (m_Extended)
+					ScrollRight<Policy::HIRES_WIDTH, Policy::HIRES_HEIGHT>();
+				else
+					ScrollRight<Policy::WIDTH, Policy::HEIGHT>();
+				events |= EVENT_REDRAW;
+				break;
+			case OP_00FC:
+				//00FC* - Scroll display 4 pixels left
+				if (m_Extended)
+					ScrollLeft<Policy::HIRES_WIDTH, Policy::HIRES_HEIGHT>();
+				else
+					ScrollLeft<Policy::WIDTH, Policy::HEIGHT>();
+				events |= EVENT_REDRAW;
+				break;
+			case OP_00FD:
+				//00FD* - Exit CHIP interpreter
+				events |= EVENT_EXIT;
+				break;
+			case OP_00FE:
+				//00FE* - Disable extended screen mode
+				m_Extended = false;
+				m_DirtyRows = ~(U64)0;
+				break;
+			case OP_00FF:
+				//00FF* - Enable extended screen mode for full - screen graphics
+				m_Extended = true;
+				m_DirtyRows = ~(U64)0;
+				break;
+			case OP_FX07_3XNN_1NNN:
+				//FX07, 3XNN, 1NNN - Waits for the delay timer, the jump is handled by 1NNN below
+				reg[op.x] = m_TimerDelay;
+				cycles++;
+				pc += 2;
+				if (reg[op.x] == op.nn2) {
+					pc += 2;
+					break;
+				}
+				cycles++;
+				pc += 2;
+				//Fall through
+			case OP_1NNN:
+				//1NNN - Jumps to address NNN.
+				//Timers only change between batches, so a delay timer spin keeps spinning until the end of the batch.
+				//Skip it and leave pc and VX where the three instruction loop would have stopped.
+				if (op.nnn + 6 == pc && m_TimerDelay != 0 && IsDelaySpin(m_Memory, pc - 2)) {
+					int skipped = maxCycles - cycles - 1;
+					if (skipped > 0)
+						reg[m_Memory[op.nnn] & 0x0F] = m_TimerDelay;
+					pc = op.nnn + 2 * (skipped % 3);
+					cycles += skipped;
+					events |= EVENT_IDLE;
+					break;
+				}
+				pc = op.nnn;
+				break;
+			case OP_2NNN:
+				//2NNN - Calls subroutine at NNN.
+				m_Stack[m_StackPointer++] = pc;
+				pc = op.nnn;
+				break;
+			case OP_3XNN:
+				//3XNN - Skips the next instruction if VX equals NN.
+				if (reg[op.x] == op.nn) {
+					pc += 2;
+				}
+				break;
+			case OP_4XNN:
+				//4XNN - Skips the next instruction if VX does not equal NN.
+				if (reg[op.x] != op.nn) {
+					pc += 2;
+				}
+				break;
+			case OP_5XY0:
+				//5XY0 - Skips the next instruction if VX equals VY.
+				if (reg[op.x] == reg[op.y]) {
+					pc += 2;
+				}
+				break;
+			case OP_6XNN:
+				//6XNN - Sets VX to NN.
+				reg[op.x] = op.nn;
+				break;
+			case OP_7XNN:
+				//7XNN - Adds NN to VX.	
+				reg[op.x] += op.nn;
+				break;
+			case OP_6XNN_6YNN:
+				//6XNN, 6YNN - Sets two registers
+				reg[op.x] = op.nn;
+				reg[op.y] = op.nn2;
+				cycles++;
+				pc += 2;
+				break;
+			case OP_7XNN_3XNN_1NNN:
+				//7XNN, 3XNN, 1NNN - Loop counter, jumps back unless VX reached NN
+				reg[op.x] += op.nn;
+				cycles++;
+				pc += 2;
+				if (reg[op.x] == op.nn2) {
+					pc += 2;
+				} else {
+					cycles++;
+					pc = op.nnn;
+				}
+				break;
+			case OP_8XY0:
+				//8XY0 - Sets VX to the value of VY.
+				reg[op.x] = reg[op.y];
+				break;
+			case OP_8XY1:
+				//8XY1 - Sets VX to VX or VY.
+				reg[op.x] = reg[op.x] | reg[op.y];
+				break;
+			case OP_8XY2:
+				//8XY2 - Sets VX to VX and VY.
+				reg[op.x] = reg[op.x] & reg[op.y];
+				break;
+			case OP_8XY3:
+				//8XY3 - Sets VX to VX xor VY.
+				reg[op.x] = reg[op.x] ^ reg[op.y];
+				break;
+			case OP_8XY4:
+				//8XY4 - Adds VY to VX. VF is set to 1 when there's a carry, and to 0 when there isn't.
+				reg[op.x] += reg[op.y];
+				reg[0xF] = 0;
+				if (reg[op.y] > (0xFF - reg[op.x])) {
+					reg[0xF] = 1;
+				}
+				break;
+			case OP_8XY5:
+				//8XY5 - VY is subtracted from VX. VF is set to 0 when there's a borrow, and 1 when there isn't.
+				reg[op.x] -= reg[op.y];
+				reg[0xF] = 1;
+				if (reg[op.y] > (0xFF - reg[op.x])) {
+					reg[0xF] = 0;
+				}
+				break;
+			case OP_8XY6:
+				//8XY6 - Shifts VX right by one. VF is set to the value of the least significant bit of VX before the shift.
+				//Store the value of register VY shifted right one bit in register VX Set register VF to the least significant bit prior to the shift
+				if (Policy::SHIFT_VY) {
+					reg[op.x] = reg[op.y];
+				}
+				reg[0xF] = reg[op.x] & 1;
+				reg[op.x] = reg[op.x] >> 1;
+				break;
+			case OP_8XY7:
+				//8XY7 - Sets VX to VY minus VX. VF is set to 0 when there's a borrow, and 1 when there isn't.
+				reg[op.x] = reg[op.y] - reg[op.x];
+				reg[0xF] = 1;
+				if (reg[op.y] < reg[op.x]) {
+					reg[0xF] = 0;
+				}
+				break;
+			case OP_8XYE:
+				//8XYE - Shifts VX left by one. VF is set to the value of the most significant bit of VX before the shift.
+				if (Policy::SHIFT_VY) {
+					reg[op.x] = reg[op.y];
+				}
+				reg[0xF] = reg[op.x] >> 7;
+				reg[op.x] = reg[op.x] << 1;
+				break;
+			case OP_9XY0:
+				//9XY0 - Skips the next instruction if VX doesn't equal VY.
+				if (reg[op.x] != reg[op.y]) {
+					pc += 2;
+				}
+				break;
+			case OP_ANNN:
+				//ANNN - Sets I to the address NNN.
+				regI = op.nnn;
+				break;
+			case OP_BNNN:
+				//BNNN - Jumps to the address NNN plus V0.
+				pc = op.nnn + reg[Policy::JUMP_VX ? op.x : 0x0];
+				break;
+			case OP_CXNN:
+				//CXNN - Sets VX to the result of a bitwise and operation on a random number and NN.
+				reg[op.x] = (NextRandom() % 0xFF) & op.nn;
+				break;
+			case OP_ANNN_DXYN:
+				//ANNN, DXYN - Sets I and draws the sprite below
+				regI = op.nnn;
+				cycles++;
+				pc += 2;
+				//Fall through
+			case OP_DXYN:
+				//DXYN*    Show N-byte sprite from M(I) at coords (VX,VY), VF := collision.If N = 0 and extended mode, show 16x16 sprite.
+
+				//DXYN - Sprites stored in memory at location in index register (I), 8bits wide. Wraps around the screen.
+				//If when drawn, clears a pixel, register VF is set to 1 otherwise it is zero. 
+				//All drawing is XOR drawing (i.e. it toggles the screen pixels). Sprites are drawn starting at position VX, VY. 
+				//N is the number of 8bit rows that need to be drawn. If N is greater than 1, second line continues at position VX, VY+1, and so on.
+				if (Policy::SUPER_OPCODES && m_Extended) {
+					if (op.n == 0)
+						reg[0xF] = DrawSprite<Policy::HIRES_WIDTH, Policy::HIRES_HEIGHT>(reg[op.x], reg[op.y], 16, 2, regI);
+					else
+						reg[0xF] = DrawSprite<Policy::HIRES_WIDTH, Policy::HIRES_HEIGHT>(reg[op.x], reg[op.y], op.n, 1, regI);
+				} else {
+					reg[0xF] = DrawSprite<Policy::WIDTH, Policy::HEIGHT>(reg[op.x], reg[op.y], op.n, 1, regI);
+				}
+				events |= EVENT_REDRAW;
+				break;
+			case OP_EX9E:
+				//EX9E - Skips the next instruction if the key stored in VX is pressed.
+				if (((m_Key >> reg[op.x]) & 1) != 0) {
+					pc += 2;
+				}
+				break;
+			case OP_EXA1:
+				//EXA1 - Skips the next instruction if the key stored in VX isn't pressed.
+				if (((m_Key >> reg[op.x]) & 1) == 0) {
+					pc += 2;
+				}
+				break;
+			case OP_FX07:
+				//FX07 - Sets VX to the value of the delay timer.
+				reg[op.x] = m_TimerDelay;
+				break;
+			case OP_FX0A:
+				//FX0A - A key press is awaited, and then stored in VX.
+				if (m_Key == 0) {
+					//Keys only change between batches, the rest of the batch would wait here as well
+					pc -= 2;
+					cycles = maxCycles - 1;
+					events |= EVENT_KEY_WAIT | EVENT_IDLE;
+				} else {
+					for (int i = 0; i <= 0xF; i++) {
+						if (((m_Key >> i) & 1) == 1) {
+							reg[op.x] = (U8)i;
+							break;
+						}
+					}
+				}
+				break;
+			case OP_FX15:
+				//FX15 - Sets the delay timer to VX.
+				m_TimerDelay = reg[op.x];
+				break;
+			case OP_FX18:
+				//FX18 - Sets the sound timer to VX.
+				if (m_TimerSound == 0 && reg[op.x] != 0) {
+					events |= EVENT_SOUND_START;
+				} else if (m_TimerSound != 0 && reg[op.x] == 0) {
+					events |= EVENT_SOUND_STOP;
+				}
+				m_TimerSound = reg[op.x];
+				break;
+			case OP_FX1E:
+				//FX1E - Adds VX to I.
+				regI += reg[op.x];
+				if (regI > 0xFFF) {
+					reg[0xF] = 1;
+				} else {
+					reg[0xF] = 0;
+				}
+				break;
+			case OP_FX29:
+				//FX29 - Sets I to the location of the sprite for the character in VX. Characters 0-F (in hexadecimal) are represented by a 4x5 font.
+				regI = reg[op.x] * 5;
+				break;
+			case OP_FX30:
+				//FX30* - Point I to 10-byte font sprite for digit VX (0..9)
+				regI = reg[op.x] * 10 + SUPERFONT_START;
+				break;
+			case OP_FX33:
+				//FX33 - Stores the Binary-coded decimal representation of VX, with the most significant of three digits at the address in I, 
+				//the middle digit at I plus 1, and the least significant digit at I plus 2. 
+				//(In other words, take the decimal representation of VX, place the hundreds digit in memory at location in I, the tens digit at location I+1, and the ones digit at location I+2.)
+			{
+				U8 number = reg[op.x];
+				U8 hundreds = 0, tens = 0, ones = 0;
+				ones = number % 10;
+				number /= 10;
+				tens = number % 10;
+				hundreds = number / 10;
+
+				m_Memory[regI] = hundreds;
+				m_Memory[regI + 1] = tens;
+				m_Memory[regI + 2] = ones;
+				InvalidateDecoded(regI, 3);
+			}
+				break;
+			case OP_FX55:
+				//FX55 - Stores V0 to VX in memory starting at address I.
+				for (int i = 0; i <= op.x; i++) {
+					m_Memory[regI + i] = reg[i];
+				}
+				InvalidateDecoded(regI, op.x + 1);
+
+				if (Policy::LOAD_STORE_INCREMENTS_I) {
+					regI += op.x + 1;
+				}
+				break;
+			case OP_FX65:
+				//FX65 - Fills V0 to VX with values from memory starting at address I.
+				for (int i = 0; i <= op.x; i++) {
+					reg[i] = m_Memory[regI + i];
+				}
+				if (Policy::LOAD_STORE_INCREMENTS_I) {
+					regI += op.x + 1;
+				}
+				break;
+			case OP_FX75:
+				//FX75* - Store V0..VX in RPL user flags (X <= 7)
+			{
+				U8 x = op.x;
+
+				if (x > 7)
+					x = 7;
+
+				for (int i = 0; i < x; i++) {
+					m_RPLUserFlags[i] = reg[i];
+				}
+			}
+				break;
+			case OP_FX85:
+				//FX85* - Read V0..VX from RPL user flags (X <= 7)
+			{
+				U8 x = op.x;
+
+				if (x > 7)
+					x = 7;
+
+				for (int i = 0; i <= x; i++) {
+					reg[i] = m_RPLUserFlags[i];
+				}
+			}
+				break;
+			default:
+				break;
+		}
+		cycles++;
+	}
+
+	memcpy(m_Reg, reg, sizeof(reg));
+	m_RegPC = pc;
+	m_RegI = regI;
+	m_DoRedraw = (events & EVENT_REDRAW) != 0;
+
+	if (executed != nullptr) {
+		*executed = cycles;
+	}
+
+	if ((events & EVENT_EXIT) != 0 && m_ExitCallback) {
+		m_ExitCallback();
+	}
+
+	return events;
+}
+
+template <class Policy>
+void Chip8Core<Policy>::InvalidateDecoded(U16 address, U16 length) {
+	//A written byte belongs to the instructions, or fused sequences, starting up to FUSED_MAX_BYTES - 1 bytes before it
+	int first = address - (FUSED_MAX_BYTES - 1);
+	int last = address + length - 1;
+	if (first < 0) {
+		//Sequences at the last addresses wrap around to address 0
+		for (int i = DECODED_SLOTS + first; i < DECODED_SLOTS; i++) {
+			m_Decoded[i].handler = OP_UNDECODED;
+		}
+		first = 0;
+	}
+	for (int i = first; i <= last && i < DECODED_SLOTS; i++) {
+		m_Decoded[i].handler = OP_UNDECODED;
+	}
+
+	if (m_CodeWriteCallback)
+		m_CodeWriteCallback(address, length);
+}
+
+template <class Policy>
+template <int W, int H>
+bool Chip8Core<Policy>::DrawSprite(U8 xInit, U8 yInit, int rows, int bytesPerRow, U16 address) {
+	static const int WORDS = W / 64;
+	U64 collision = 0;
+
+	if (!Policy::SPRITE_WRAP) {
+		xInit %= W;
+		yInit %= H;
+	}
+
+	//A sprite row covers part of one word and may spill into the next one
+	int word = (xInit % W) / 64;
+	int shift = xInit % 64;
+	int spillWord = word + 1 < WORDS ? word + 1 : Policy::SPRITE_WRAP ? 0 : -1;
+
+	for (int y = 0; y < rows; y++) {
+		if (!Policy::SPRITE_WRAP && yInit + y >= H)
+			break;
+
+		//Sprite row with its first pixel in the most significant bit
+		U64 bits;
+		if (bytesPerRow == 2)
+			bits = (U64)((m_Memory[address + y * 2] << 8) | m_Memory[address + y * 2 + 1]) << 48;
+		else
+			bits = (U64)m_Memory[address + y] << 56;
+
+		if (bits == 0)
+			continue;
+
+		int rowIndex = (yInit + y) % H;
+		m_DirtyRows |= (U64)1 << rowIndex;
+		U64* row = m_Plane + rowIndex * PLANE_WORDS;
+		U64 first = bits >> shift;
+		collision |= row[word] & first;
+		row[word] ^= first;
+
+		if (shift != 0 && spillWord >= 0) {
+			U64 spill = bits << (64 - shift);
+			collision |= row[spillWord] & spill;
+			row[spillWord] ^= spill;
+		}
+	}
+
+	return collision != 0;
+}
+
+template <class Policy>
+template <int W, int H>
+void Chip8Core<Policy>::ScrollDown(int lines) {
+	ScrollPlaneDown(m_Plane, PLANE_WORDS, W / 64, H, lines);
+	if (lines != 0)
+		m_DirtyRows |= RowMask(H);
+}
+
+template <class Policy>
+template <int W, int H>
+void Chip8Core<Policy>::ScrollRight() {
+	ScrollPlaneRight4(m_Plane, PLANE_WORDS, W / 64, H);
+	m_DirtyRows |= RowMask(H);
+}
+
+template <class Policy>
+template <int W, int H>
+void Chip8Core<Policy>::ScrollLeft() {
+	ScrollPlaneLeft4(m_Plane, PLANE_WORDS, W / 64, H);
+	m_DirtyRows |= RowMask(H);
+}
+
+template <class Policy>
+void Chip8Core<Policy>::RowsToRGBA(U32* pixels, int firstRow, int rowCount) const {
+	int width = Width();
+	for (int y = firstRow; y < firstRow + rowCount; y++) {
+		const U64* row = m_Plane + y * PLANE_WORDS;
+		for (int x = 0; x < width; x++) {
+			*pixels++ = ((row[x / 64] >> (63 - x % 64)) & 1) != 0 ? 0xFFFFFFFF : 0x000000FF;
+		}
+	}
+}
+
+template <class Policy>
+void Chip8Core<Policy>::LoadState(const State& state) {
+	//Compared in blocks, only the runs of changed bytes in a block with any change are decoded again. Run-ahead restores
+	//the data its frames wrote on every frame, the code around it stays compiled. Each run is copied before it is
+	//reported, so the code write callback sees the restored bytes.
+	const int BLOCK = 64;
+	for (int address = 0; address < (int)sizeof(m_Memory); address += BLOCK) {
+		if (memcmp(m_Memory + address, state.m_Memory + address, BLOCK) == 0)
+			continue;
+		for (int i = address; i < address + BLOCK; i++) {
+			if (m_Memory[i] == state.m_Memory[i])
+				continue;
+			int start = i;
+			while (i < address + BLOCK && m_Memory[i] != state.m_Memory[i]) {
+				m_Memory[i] = state.m_Memory[i];
+				i++;
+			}
+			InvalidateDecoded((U16)start, (U16)(i - start));
+		}
+	}
+	static_cast<State&>(*this) = state;
+}
+
+template <class Policy>
+void Chip8Core<Policy>::DecreaseTimers() {
+	//The timers are unsigned, they stop at 0 instead of wrapping around
+	if (m_TimerDelay > 0) {
+		--m_TimerDelay;
+	}
+
+	if (m_TimerSound > 0) {
+		--m_TimerSound;
+	}
+}
+
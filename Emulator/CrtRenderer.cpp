@@ -0,0 +1,130 @@
+#include "CrtRenderer.h"
+#include <cmath>
+#include <fstream>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define CRT_SSE2_ENABLED
+#include <emmintrin.h>
+#endif
+
+//Constants of fragmentShader.glsl
+static const float DISTORTION = 0.2f;
+static const float SCANLINE_FREQUENCY = 32 * 40;
+static const float PI = 3.1415f;
+
+CrtRenderer::CrtRenderer(int width, int height) {
+	m_Width = width;
+	m_Height = height;
+	m_SourceX.resize(width * height);
+	m_SourceY.resize(width * height);
+	m_Weight.resize(width * height);
+	SetPalette(0xFFFFFF, 0x000000);
+
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			//BarrelDistort, UV is the center of the output pixel
+			float u = (x + 0.5f) / width - 0.5f;
+			float v = (y + 0.5f) / height - 0.5f;
+			float rd = sqrtf(u * u + v * v);
+			if (rd > 0) {
+				float ru = rd * (1 + DISTORTION * rd * rd);
+				u = u / rd * ru;
+				v = v / rd * ru;
+			}
+			u = fminf(fmaxf(u + 0.5f, 0), 1);
+			v = fminf(fmaxf(v + 0.5f, 0), 1);
+
+			int i = y * width + x;
+			m_SourceX[i] = u < 1 ? (U16)(u * 4096) : 4096;
+			m_SourceY[i] = v < 1 ? (U16)(v * 4096) : 4096;
+
+			float scanline = 0.1f * sinf(v * SCANLINE_FREQUENCY) * 2 + 0.9f;
+			float vignette = fminf(fmaxf(powf(sinf(u * PI) * sinf(v * PI), 0.25f), 0), 1);
+			m_Weight[i] = scanline * vignette;
+		}
+	}
+}
+
+void CrtRenderer::SetPalette(U32 onColor, U32 offColor) {
+	//The shader divides by 1.2 and adds 0.15 on every channel, alpha included. Outside the display the color is 0.
+	U32 colors[2] = { onColor, offColor };
+	for (int i = 0; i < 2; i++) {
+		m_Colors[i][0] = ((colors[i] >> 16) & 0xFF) / 255.0f / 1.2f + 0.15f;
+		m_Colors[i][1] = ((colors[i] >> 8) & 0xFF) / 255.0f / 1.2f + 0.15f;
+		m_Colors[i][2] = (colors[i] & 0xFF) / 255.0f / 1.2f + 0.15f;
+		m_Colors[i][3] = 1 / 1.2f + 0.15f;
+	}
+	for (int c = 0; c < 4; c++) {
+		m_Colors[2][c] = 0.15f;
+	}
+}
+
+void CrtRenderer::Render(const U64* plane, int planeWords, int displayWidth, int displayHeight, U8* out) const {
+	int count = m_Width * m_Height;
+	int i = 0;
+
+#if defined(CRT_SSE2_ENABLED)
+	//Four pixels at a time, each color is scaled by its weight and the four are packed to bytes together
+	__m128 scale = _mm_set1_ps(255.0f);
+	__m128 colors[3];
+	for (int c = 0; c < 3; c++) {
+		colors[c] = _mm_mul_ps(_mm_loadu_ps(m_Colors[c]), scale);
+	}
+	for (; i + 4 <= count; i += 4) {
+		__m128i pixels[4];
+		for (int k = 0; k < 4; k++) {
+			int x = (m_SourceX[i + k] * displayWidth) >> 12;
+			int y = (m_SourceY[i + k] * displayHeight) >> 12;
+			int color = 2;
+			if (x < displayWidth && y < displayHeight)
+				color = ((plane[y * planeWords + x / 64] >> (63 - x % 64)) & 1) != 0 ? 0 : 1;
+			pixels[k] = _mm_cvtps_epi32(_mm_mul_ps(colors[color], _mm_set1_ps(m_Weight[i + k])));
+		}
+		__m128i low = _mm_packs_epi32(pixels[0], pixels[1]);
+		__m128i high = _mm_packs_epi32(pixels[2], pixels[3]);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 4), _mm_packus_epi16(low, high));
+	}
+#endif
+
+	for (; i < count; i++) {
+		int x = (m_SourceX[i] * displayWidth) >> 12;
+		int y = (m_SourceY[i] * displayHeight) >> 12;
+		int color = 2;
+		if (x < displayWidth && y < displayHeight)
+			color = ((plane[y * planeWords + x / 64] >> (63 - x % 64)) & 1) != 0 ? 0 : 1;
+		for (int c = 0; c < 4; c++) {
+			float value = m_Colors[color][c] * m_Weight[i] * 255.0f + 0.5f;
+			out[i * 4 + c] = value >= 255 ? 255 : (U8)value;
+		}
+	}
+}
+
+bool CrtRenderer::WriteTga(const char* path, const U8* pixels, int width, int height) {
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	//Uncompressed true color, 32 bits per pixel with 8 alpha bits, top row first
+	U8 header[18] = { 0, 0, 2 };
+	header[12] = width & 0xFF;
+	header[13] = (width >> 8) & 0xFF;
+	header[14] = height & 0xFF;
+	header[15] = (height >> 8) & 0xFF;
+	header[16] = 32;
+	header[17] = 0x28;
+	file.write((const char*)header, sizeof(header));
+
+	//TGA stores B, G, R, A
+	std::vector<U8> row(width * 4);
+	for (int y = 0; y < height; y++) {
+		const U8* source = pixels + y * width * 4;
+		for (int x = 0; x < width; x++) {
+			row[x * 4 + 0] = source[x * 4 + 2];
+			row[x * 4 + 1] = source[x * 4 + 1];
+			row[x * 4 + 2] = source[x * 4 + 0];
+			row[x * 4 + 3] = source[x * 4 + 3];
+		}
+		file.write((const char*)row.data(), row.size());
+	}
+	return file.good();
+}
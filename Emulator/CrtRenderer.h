@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+
+#include "OpCode.h"
+
+//Renders the display the way Resources/fragmentShader.glsl does, without a GPU and at any output size: barrel
+//distortion, brightness remap, scanlines and vignette. Used for thumbnails on machines without OpenGL and as a
+//reference for changes to the shader. It matches the shader to within one step per channel, except for output pixels
+//whose distorted position is within rounding of a display pixel edge, where the GPU may pick the neighboring pixel.
+//
+//Everything that depends only on the output position is computed once: where each output pixel samples the display
+//and the product of its scanline and vignette factors. Rendering a frame looks up the sampled pixels and scales
+//their colors.
+struct CrtRenderer {
+	int m_Width;
+	int m_Height;
+	//Distorted position of each output pixel in 1/4096 of the display, 4096 past the right or bottom edge
+	std::vector<U16> m_SourceX;
+	std::vector<U16> m_SourceY;
+	//Scanline and vignette factor of each output pixel
+	std::vector<float> m_Weight;
+	//Remapped RGBA colors of set pixels, clear pixels and the area outside the display
+	float m_Colors[3][4];
+
+	CrtRenderer(int width, int height);
+
+	int Width() const { return m_Width; }
+	int Height() const { return m_Height; }
+	//Colors as RRGGBB like the -palette option
+	void SetPalette(U32 onColor, U32 offColor);
+
+	//Renders the first displayWidth pixels of displayHeight rows of a display plane, planeWords words per row with
+	//pixel x in bit 63 - x % 64 of word x / 64. Writes Width() * Height() pixels as R, G, B, A bytes, top row first.
+	//The distortion is exact for power of two display sizes.
+	void Render(const U64* plane, int planeWords, int displayWidth, int displayHeight, U8* out) const;
+	template <class Emulator> void Render(const Emulator& emulator, U8* out) const {
+		Render(emulator.m_Plane, Emulator::PLANE_WORDS, emulator.Width(), emulator.Height(), out);
+	}
+
+	//Writes RGBA pixels, top row first, as an uncompressed 32 bit TGA
+	static bool WriteTga(const char* path, const U8* pixels, int width, int height);
+};
@@ -0,0 +1,47 @@
+#include "FrameBlender.h"
+#include <cstring>
+
+FrameBlender::FrameBlender(int words, int rows, int frames) {
+	m_Words = words;
+	m_Rows = rows;
+	m_Plane.resize(words * rows);
+	SetFrames(frames);
+}
+
+void FrameBlender::SetFrames(int frames) {
+	m_Frames = frames < 1 ? 1 : frames > MAX_FRAMES ? MAX_FRAMES : frames;
+	m_Slot = 0;
+	m_History.assign(m_Frames * m_Words * m_Rows, 0);
+	//An empty history is a blank display, every row is rebuilt over the next N frames
+	for (int i = 0; i < MAX_FRAMES; i++) {
+		m_Recent[i] = ~(U64)0;
+	}
+}
+
+U64 FrameBlender::Blend(const U64* plane, U64 dirtyRows) {
+	m_Recent[m_Slot] = dirtyRows;
+	//A row unchanged in all of the last N frames is the same in every slot, and so in the output
+	U64 rows = 0;
+	for (int i = 0; i < m_Frames; i++) {
+		rows |= m_Recent[i];
+	}
+
+	const int planeSize = m_Words * m_Rows;
+	U64* slot = m_History.data() + m_Slot * planeSize;
+	for (int y = 0; y < m_Rows; y++) {
+		if (((rows >> y) & 1) == 0)
+			continue;
+		int row = y * m_Words;
+		memcpy(slot + row, plane + row, m_Words * sizeof(U64));
+		for (int w = 0; w < m_Words; w++) {
+			U64 bits = 0;
+			for (int i = 0; i < m_Frames; i++) {
+				bits |= m_History[i * planeSize + row + w];
+			}
+			m_Plane[row + w] = bits;
+		}
+	}
+
+	m_Slot = m_Slot + 1 == m_Frames ? 0 : m_Slot + 1;
+	return rows;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+
+#include "OpCode.h"
+
+//Hides the flicker of XOR drawn sprites: a pixel is shown as set when it was set in any of the last N frames. Sprites
+//that are erased and redrawn between two frames stay visible, a pixel that is really cleared goes dark N - 1 frames late.
+//
+//The output is kept up to date from the dirty rows of the core. A row can only change in the output when it changed in
+//the core during the last N frames, so those are the only rows copied into the history and recombined. A still screen
+//costs nothing once N frames have passed.
+struct FrameBlender {
+	static const int MAX_FRAMES = 16;
+
+	int m_Words;
+	int m_Rows;
+	int m_Frames;
+	//Slot of the frame being added next
+	int m_Slot;
+	//The last N frames, one plane per slot
+	std::vector<U64> m_History;
+	//Dirty rows each of the last N frames was added with
+	U64 m_Recent[MAX_FRAMES];
+	std::vector<U64> m_Plane;
+
+	//Planes of rows rows of words words, the layout of the core's m_Plane
+	FrameBlender(int words, int rows, int frames = 1);
+
+	//Number of frames combined, 1 passes frames through unchanged. Clears the history.
+	void SetFrames(int frames);
+	int Frames() const { return m_Frames; }
+
+	//Adds a frame and returns the rows of Plane() that changed. dirtyRows are the rows that changed in plane since the
+	//last frame, as returned by TakeDirtyRows.
+	U64 Blend(const U64* plane, U64 dirtyRows);
+	const U64* Plane() const { return m_Plane.data(); }
+};
@@ -0,0 +1,109 @@
+#include "FrameUploader.h"
+#include <chrono>
+
+static double Now() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+FrameUploader::FrameUploader(int width, int height, int texelBytes, GLenum format, GLenum type) {
+	m_Width = width;
+	m_TexelBytes = texelBytes;
+	m_Format = format;
+	m_Type = type;
+	m_Size = RowBytes() * height;
+	m_Current = RING_SIZE - 1;
+	m_Mapped = nullptr;
+	m_ClientRows = new U8[m_Size];
+	m_RunCount = 0;
+	m_Timing = Timing();
+	m_MapTime = 0;
+
+	glGenBuffers(RING_SIZE, m_Buffers);
+	glGenQueries(RING_SIZE, m_Queries);
+	for (int i = 0; i < RING_SIZE; i++) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_Buffers[i]);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, m_Size, nullptr, GL_STREAM_DRAW);
+		m_Fences[i] = nullptr;
+		m_QueryPending[i] = false;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+FrameUploader::~FrameUploader() {
+	for (int i = 0; i < RING_SIZE; i++) {
+		if (m_Fences[i] != nullptr)
+			glDeleteSync(m_Fences[i]);
+	}
+	glDeleteQueries(RING_SIZE, m_Queries);
+	glDeleteBuffers(RING_SIZE, m_Buffers);
+	delete[] m_ClientRows;
+}
+
+U8* FrameUploader::Map() {
+	m_Current = (m_Current + 1) % RING_SIZE;
+	m_RunCount = 0;
+
+	double start = Now();
+	if (m_Fences[m_Current] != nullptr) {
+		//Three frames old, so normally signaled already
+		while (glClientWaitSync(m_Fences[m_Current], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {
+		}
+		glDeleteSync(m_Fences[m_Current]);
+		m_Fences[m_Current] = nullptr;
+	}
+	m_MapTime = Now();
+	m_Timing.wait = m_MapTime - start;
+
+	//The fence covers the query too, its result is ready without stalling
+	m_Timing.gpu = -1;
+	if (m_QueryPending[m_Current]) {
+		GLuint64 elapsed;
+		glGetQueryObjectui64v(m_Queries[m_Current], GL_QUERY_RESULT, &elapsed);
+		m_Timing.gpu = elapsed / 1e9;
+		m_QueryPending[m_Current] = false;
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_Buffers[m_Current]);
+	m_Mapped = (U8*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, m_Size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return m_Mapped != nullptr ? m_Mapped : m_ClientRows;
+}
+
+void FrameUploader::AddRows(int firstRow, int rowCount) {
+	if (m_RunCount == MAX_RUNS)
+		return;
+	m_Runs[m_RunCount].firstRow = firstRow;
+	m_Runs[m_RunCount].rowCount = rowCount;
+	m_RunCount++;
+}
+
+void FrameUploader::Upload() {
+	double start = Now();
+	m_Timing.write = start - m_MapTime;
+
+	const U8* base = m_ClientRows;
+	if (m_Mapped != nullptr) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_Buffers[m_Current]);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		m_Mapped = nullptr;
+		//With a buffer bound the pointer is an offset into it
+		base = nullptr;
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, m_Queries[m_Current]);
+	for (int i = 0; i < m_RunCount; i++) {
+		const Run& run = m_Runs[i];
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, run.firstRow, m_Width, run.rowCount, m_Format, m_Type, base + run.firstRow * RowBytes());
+	}
+	glEndQuery(GL_TIME_ELAPSED);
+	m_QueryPending[m_Current] = true;
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	m_Fences[m_Current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_RunCount = 0;
+
+	m_Timing.submit = Now() - start;
+	if (m_TimingCallback)
+		m_TimingCallback(m_Timing);
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <functional>
+
+#include <glad/glad.h>
+
+#include "OpCode.h"
+
+//Streams display rows to the texture bound to GL_TEXTURE_2D through a ring of pixel buffer objects.
+//Each frame maps the next buffer without letting the driver synchronize, the emulator writes the changed rows straight
+//into it and the texture copies are read from the buffer by the GPU. A fence after the copies keeps the buffer from
+//being mapped again before the GPU is done with it. When a buffer cannot be mapped the rows go through client memory.
+//
+//	U8* rows = uploader.Map();
+//	memcpy(rows + first * uploader.RowBytes(), source, count * uploader.RowBytes());
+//	uploader.AddRows(first, count);
+//	uploader.Upload();
+struct FrameUploader {
+	static const int RING_SIZE = 3;
+	//Runs of rows queued between Map and Upload, one per display row at most
+	static const int MAX_RUNS = 64;
+
+	//Per frame timing in seconds, passed to the timing callback after Upload
+	struct Timing {
+		//Waiting in Map for the GPU to finish with the buffer
+		double wait;
+		//From Map to Upload, writing the rows
+		double write;
+		//Unmapping the buffer and issuing the texture copies
+		double submit;
+		//GPU time of the copies issued the last time this buffer was used, negative until a result is known
+		double gpu;
+	};
+
+	struct Run {
+		int firstRow;
+		int rowCount;
+	};
+
+	GLuint m_Buffers[RING_SIZE];
+	GLsync m_Fences[RING_SIZE];
+	GLuint m_Queries[RING_SIZE];
+	bool m_QueryPending[RING_SIZE];
+	int m_Current;
+	//Bytes in each buffer
+	int m_Size;
+	U8* m_Mapped;
+	//Used when mapping fails
+	U8* m_ClientRows;
+
+	//Rows are m_Width texels of m_TexelBytes bytes, in m_Format and m_Type
+	int m_Width;
+	int m_TexelBytes;
+	GLenum m_Format;
+	GLenum m_Type;
+
+	Run m_Runs[MAX_RUNS];
+	int m_RunCount;
+
+	Timing m_Timing;
+	double m_MapTime;
+	std::function<void(const Timing&)> m_TimingCallback;
+
+	//Uploads rows of width texels to a texture of up to height rows, with glTexSubImage2D's format and type
+	FrameUploader(int width, int height, int texelBytes, GLenum format, GLenum type);
+	~FrameUploader();
+
+	int RowBytes() const { return m_Width * m_TexelBytes; }
+	//Returns the buffer to write this frame's rows to, row y starts at y * RowBytes()
+	U8* Map();
+	//Queues rows of the buffer returned by Map for the next Upload
+	void AddRows(int firstRow, int rowCount);
+	//Copies the queued rows to the texture bound to GL_TEXTURE_2D
+	void Upload();
+
+	void SetTimingCallback(std::function<void(const Timing&)> callback) { m_TimingCallback = callback; }
+};
@@ -0,0 +1,53 @@
+#include "KeyInput.h"
+#include <cstring>
+
+KeyMap::KeyMap() {
+	memset(m_Keys, NONE, sizeof(m_Keys));
+}
+
+void KeyMap::Set(int hostKey, U8 key) {
+	if (hostKey >= 0 && hostKey < SIZE)
+		m_Keys[hostKey] = key;
+}
+
+bool KeyInput::Push(U8 key, bool pressed) {
+	KeyEvent* event = m_Events.Reserve();
+	if (event == nullptr)
+		return false;
+	event->time = std::chrono::steady_clock::now();
+	event->key = key;
+	event->pressed = pressed;
+	m_Events.Commit();
+	return true;
+}
+
+int KeyInput::NextEventOffset(int instructions, int done, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+	const KeyEvent* event = m_Events.Front();
+	if (event == nullptr || event->time > end)
+		return -1;
+
+	int offset = 0;
+	if (event->time > start && end > start)
+		offset = (int)(instructions * std::chrono::duration<double>(event->time - start).count() / std::chrono::duration<double>(end - start).count());
+	if (offset < done)
+		offset = done;
+	//Releasing a key no instruction saw pressed yet waits for one instruction, in the next tick when this one is done
+	if (!event->pressed && ((m_NewPresses >> event->key) & 1) != 0 && offset == done) {
+		offset = done + 1;
+		if (offset > instructions)
+			return -1;
+	}
+	return offset;
+}
+
+void KeyInput::ApplyNext() {
+	const KeyEvent* event = m_Events.Front();
+	U16 bit = (U16)(1 << event->key);
+	if (event->pressed) {
+		m_Keys |= bit;
+		m_NewPresses |= bit;
+	} else {
+		m_Keys &= ~bit;
+	}
+	m_Events.Pop();
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <chrono>
+
+#include "OpCode.h"
+#include "SpscQueue.h"
+
+//Host key codes to CHIP-8 keys, a flat table covering every GLFW key code
+struct KeyMap {
+	static const int SIZE = 512;
+	static const U8 NONE = 0xFF;
+
+	U8 m_Keys[SIZE];
+
+	KeyMap();
+	void Set(int hostKey, U8 key);
+	//NONE for keys that are not mapped or out of range
+	U8 Get(int hostKey) const { return hostKey >= 0 && hostKey < SIZE ? m_Keys[hostKey] : NONE; }
+};
+
+struct KeyEvent {
+	std::chrono::steady_clock::time_point time;
+	U8 key;
+	bool pressed;
+};
+
+//Key presses and releases from the window thread, applied by the emulation thread between the instructions that match
+//their time. A tick that covers wall time start to end runs its instructions spread evenly over that time, an event at
+//time t is applied before instruction (t - start) / (end - start) of them. A press always lasts at least one
+//instruction so that short taps are not lost.
+struct KeyInput {
+	static const int QUEUE_SIZE = 256;
+
+	SpscQueue<KeyEvent, QUEUE_SIZE> m_Events;
+	//Emulation thread: keys held down, and keys pressed since instructions last ran
+	U16 m_Keys;
+	U16 m_NewPresses;
+
+	KeyInput() : m_Keys(0), m_NewPresses(0) {}
+
+	//Window thread, stamped with the current time. False when the queue is full and the event was dropped.
+	bool Push(U8 key, bool pressed);
+
+	//Emulation thread: runs a tick of instructions instructions covering start to end through run(count), setting keys
+	//to the held keys before each call. Events after end stay queued for the next tick.
+	template <class Run> void RunTick(U16& keys, int instructions, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end, Run run) {
+		int done = 0;
+		int offset;
+		while ((offset = NextEventOffset(instructions, done, start, end)) >= 0) {
+			if (offset > done) {
+				keys = m_Keys;
+				run(offset - done);
+				done = offset;
+				m_NewPresses = 0;
+			}
+			ApplyNext();
+		}
+		keys = m_Keys;
+		if (instructions > done) {
+			run(instructions - done);
+			m_NewPresses = 0;
+		}
+	}
+
+private:
+	//Instruction the next event applies before, never before done, or -1 when it belongs to a later tick
+	int NextEventOffset(int instructions, int done, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+	void ApplyNext();
+};
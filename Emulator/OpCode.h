@@ -0,0 +1,248 @@
+#pragma once
+
+typedef unsigned char U8;
+typedef unsigned short U16;
+typedef unsigned int U32;
+typedef unsigned long long U64;
+
+//Handler index of a predecoded instruction, named after the opcode pattern it executes.
+enum OpHandler : U8 {
+	OP_UNDECODED = 0,	//Cache slot is empty and has to be decoded before use
+	OP_NOP,				//Unknown opcode, ignored
+
+	OP_00CN,
+	OP_00E0,
+	OP_00EE,
+	OP_00FB,
+	OP_00FC,
+	OP_00FD,
+	OP_00FE,
+	OP_00FF,
+	OP_1NNN,
+	OP_2NNN,
+	OP_3XNN,
+	OP_4XNN,
+	OP_5XY0,
+	OP_6XNN,
+	OP_7XNN,
+	OP_8XY0,
+	OP_8XY1,
+	OP_8XY2,
+	OP_8XY3,
+	OP_8XY4,
+	OP_8XY5,
+	OP_8XY6,
+	OP_8XY7,
+	OP_8XYE,
+	OP_9XY0,
+	OP_ANNN,
+	OP_BNNN,
+	OP_CXNN,
+	OP_DXYN,
+	OP_EX9E,
+	OP_EXA1,
+	OP_FX07,
+	OP_FX0A,
+	OP_FX15,
+	OP_FX18,
+	OP_FX1E,
+	OP_FX29,
+	OP_FX30,
+	OP_FX33,
+	OP_FX55,
+	OP_FX65,
+	OP_FX75,
+	OP_FX85,
+
+	//Fused sequences, the first instruction keeps its operands in the usual fields
+	OP_6XNN_6YNN,		//6XNN, 6YNN: Y and NN of the second instruction in y and nn2
+	OP_ANNN_DXYN,		//ANNN, DXYN: I in nnn, the sprite in x, y and n
+	OP_7XNN_3XNN_1NNN,	//7XNN, 3XNN, 1NNN on the same X: compared value in nn2, jump target in nnn
+	OP_FX07_3XNN_1NNN	//FX07, 3XNN, 1NNN on the same X: compared value in nn2, jump target in nnn
+};
+
+//First fused handler, everything from here on executes more than one instruction.
+static const U8 OP_FUSED_FIRST = OP_6XNN_6YNN;
+//Longest fused sequence in bytes.
+static const int FUSED_MAX_BYTES = 6;
+
+//An instruction with its operands already extracted from the opcode.
+struct DecodedOp {
+	U8 handler;
+	U8 x;
+	U8 y;
+	U8 n;
+	U8 nn;
+	U8 nn2;
+	U16 nnn;
+};
+
+//Number of instruction slots in memory, one for every address since roms may jump to odd addresses.
+static const int DECODED_SLOTS = 4096;
+
+//Decodes a single opcode. SuperChip only opcodes decode to OP_NOP when superChip is false.
+inline DecodedOp DecodeOpCode(U16 opCode, bool superChip) {
+	DecodedOp op;
+	op.handler = OP_NOP;
+	op.x = (opCode & 0x0F00) >> 8;
+	op.y = (opCode & 0x00F0) >> 4;
+	op.n = opCode & 0x000F;
+	op.nn = opCode & 0x00FF;
+	op.nn2 = 0;
+	op.nnn = opCode & 0x0FFF;
+
+	switch (opCode & 0xF000) {
+		case 0x0000:
+			if (!superChip) {
+				if (opCode == 0x00E0)
+					op.handler = OP_00E0;
+				else if (opCode == 0x00EE)
+					op.handler = OP_00EE;
+				break;
+			}
+			if ((opCode & 0xF0) == 0xC0) {
+				op.handler = OP_00CN;
+				break;
+			}
+			switch (opCode & 0xFF) {
+				case 0xE0: op.handler = OP_00E0; break;
+				case 0xEE: op.handler = OP_00EE; break;
+				case 0xFB: op.handler = OP_00FB; break;
+				case 0xFC: op.handler = OP_00FC; break;
+				case 0xFD: op.handler = OP_00FD; break;
+				case 0xFE: op.handler = OP_00FE; break;
+				case 0xFF: op.handler = OP_00FF; break;
+				default: break;
+			}
+			break;
+		case 0x1000: op.handler = OP_1NNN; break;
+		case 0x2000: op.handler = OP_2NNN; break;
+		case 0x3000: op.handler = OP_3XNN; break;
+		case 0x4000: op.handler = OP_4XNN; break;
+		case 0x5000: op.handler = OP_5XY0; break;
+		case 0x6000: op.handler = OP_6XNN; break;
+		case 0x7000: op.handler = OP_7XNN; break;
+		case 0x8000:
+			switch (opCode & 0x000F) {
+				case 0x0: op.handler = OP_8XY0; break;
+				case 0x1: op.handler = OP_8XY1; break;
+				case 0x2: op.handler = OP_8XY2; break;
+				case 0x3: op.handler = OP_8XY3; break;
+				case 0x4: op.handler = OP_8XY4; break;
+				case 0x5: op.handler = OP_8XY5; break;
+				case 0x6: op.handler = OP_8XY6; break;
+				case 0x7: op.handler = OP_8XY7; break;
+				case 0xE: op.handler = OP_8XYE; break;
+				default: break;
+			}
+			break;
+		case 0x9000: op.handler = OP_9XY0; break;
+		case 0xA000: op.handler = OP_ANNN; break;
+		case 0xB000: op.handler = OP_BNNN; break;
+		case 0xC000: op.handler = OP_CXNN; break;
+		case 0xD000: op.handler = OP_DXYN; break;
+		case 0xE000:
+			if ((opCode & 0x00FF) == 0x009E)
+				op.handler = OP_EX9E;
+			else if ((opCode & 0x00FF) == 0x00A1)
+				op.handler = OP_EXA1;
+			break;
+		case 0xF000:
+			switch (opCode & 0x00FF) {
+				case 0x07: op.handler = OP_FX07; break;
+				case 0x0A: op.handler = OP_FX0A; break;
+				case 0x15: op.handler = OP_FX15; break;
+				case 0x18: op.handler = OP_FX18; break;
+				case 0x1E: op.handler = OP_FX1E; break;
+				case 0x29: op.handler = OP_FX29; break;
+				case 0x30: if (superChip) op.handler = OP_FX30; break;
+				case 0x33: op.handler = OP_FX33; break;
+				case 0x55: op.handler = OP_FX55; break;
+				case 0x65: op.handler = OP_FX65; break;
+				case 0x75: if (superChip) op.handler = OP_FX75; break;
+				case 0x85: if (superChip) op.handler = OP_FX85; break;
+				default: break;
+			}
+			break;
+		default:
+			break;
+	}
+
+	return op;
+}
+
+//Combines first with the two opcodes that follow it when they form a sequence with a fused handler.
+inline DecodedOp FuseOpCodes(DecodedOp first, U16 second, U16 third) {
+	DecodedOp op = first;
+	U8 secondX = (second & 0x0F00) >> 8;
+
+	switch (first.handler) {
+		case OP_6XNN:
+			if ((second & 0xF000) == 0x6000) {
+				op.handler = OP_6XNN_6YNN;
+				op.y = secondX;
+				op.nn2 = second & 0x00FF;
+			}
+			break;
+		case OP_ANNN:
+			if ((second & 0xF000) == 0xD000) {
+				op.handler = OP_ANNN_DXYN;
+				op.x = secondX;
+				op.y = (second & 0x00F0) >> 4;
+				op.n = second & 0x000F;
+			}
+			break;
+		case OP_7XNN:
+		case OP_FX07:
+			if ((second & 0xF000) == 0x3000 && secondX == first.x && (third & 0xF000) == 0x1000) {
+				op.handler = first.handler == OP_7XNN ? OP_7XNN_3XNN_1NNN : OP_FX07_3XNN_1NNN;
+				op.nn2 = second & 0x00FF;
+				op.nnn = third & 0x0FFF;
+			}
+			break;
+		default:
+			break;
+	}
+
+	return op;
+}
+
+//Number of instructions a fused handler may execute.
+inline int FusedLength(U8 handler) {
+	return handler >= OP_7XNN_3XNN_1NNN ? 3 : 2;
+}
+
+//Handler of the first instruction of a fused sequence.
+inline U8 UnfusedHandler(U8 handler) {
+	switch (handler) {
+		case OP_6XNN_6YNN: return OP_6XNN;
+		case OP_ANNN_DXYN: return OP_ANNN;
+		case OP_7XNN_3XNN_1NNN: return OP_7XNN;
+		case OP_FX07_3XNN_1NNN: return OP_FX07;
+		default: return handler;
+	}
+}
+
+//True when address holds a 1NNN that jumps back to an FX07 followed by a 3X00 on the same register,
+//the loop roms use to wait until the delay timer reaches zero.
+inline bool IsDelaySpin(const U8* memory, U16 address) {
+	if (address < 4 || address + 1 >= 4096)
+		return false;
+
+	U16 target = address - 4;
+	U8 x = memory[target] & 0x0F;
+	return memory[address] == (0x10 | (target >> 8)) && memory[address + 1] == (target & 0xFF) &&
+		memory[target] == (0xF0 | x) && memory[target + 1] == 0x07 &&
+		memory[target + 2] == (0x30 | x) && memory[target + 3] == 0x00;
+}
+
+//Flags returned by RunCycles and RunUntil for everything that happened during a batch.
+enum RunEvent : U32 {
+	EVENT_NONE = 0,
+	EVENT_REDRAW = 1 << 0,		//The framebuffer changed
+	EVENT_KEY_WAIT = 1 << 1,	//FX0A is waiting for a key press
+	EVENT_EXIT = 1 << 2,		//00FD, the rom asked to exit
+	EVENT_SOUND_START = 1 << 3,	//The sound timer was started from zero
+	EVENT_IDLE = 1 << 4,		//The rom only waits for a key or the delay timer, the rest of the batch was skipped
+	EVENT_SOUND_STOP = 1 << 5	//FX18 stopped the sound timer
+};
@@ -0,0 +1,78 @@
+#include "RecompiledRom.h"
+#include <cstring>
+
+static RecompiledRom* gRecompiledRoms = nullptr;
+
+RecompiledRomRegistrar::RecompiledRomRegistrar(RecompiledRom& rom) {
+	rom.next = gRecompiledRoms;
+	gRecompiledRoms = &rom;
+}
+
+RecompiledRom* FirstRecompiledRom() {
+	return gRecompiledRoms;
+}
+
+RecompiledRunner::RecompiledRunner(SuperChip& chip) : m_Chip(chip), m_Rom(nullptr), m_Match(true) {
+	memset(m_Modified, 0, sizeof(m_Modified));
+	m_Chip.SetCodeWriteCallback([this](U16 address, U16 length) { Invalidate(address, length); });
+}
+
+RecompiledRunner::~RecompiledRunner() {
+	m_Chip.SetCodeWriteCallback(nullptr);
+}
+
+U32 RecompiledRunner::Run(int cycles) {
+	return RunUntil(EVENT_EXIT, cycles);
+}
+
+U32 RecompiledRunner::RunUntil(U32 stopEvents, int maxCycles, int* executed) {
+	if (m_Match)
+		Match();
+
+	int done = 0;
+	U32 events;
+	if (m_Rom != nullptr)
+		events = m_Rom->run(m_Chip, m_Modified, stopEvents, maxCycles, &done);
+	else
+		events = m_Chip.RunUntil(stopEvents, maxCycles, &done);
+
+	if (executed != nullptr)
+		*executed = done;
+	m_Chip.m_DoRedraw = (events & EVENT_REDRAW) != 0;
+	return events;
+}
+
+void RecompiledRunner::Match() {
+	m_Match = false;
+	m_Rom = nullptr;
+	memset(m_Modified, 0, sizeof(m_Modified));
+
+	//Bytes past the image are never part of recovered code, a longer rom with the same start can use it as well
+	for (RecompiledRom* rom = FirstRecompiledRom(); rom != nullptr; rom = rom->next) {
+		if (memcmp(m_Chip.m_Memory + 0x200, rom->image, rom->imageSize) == 0) {
+			m_Rom = rom;
+			return;
+		}
+	}
+}
+
+void RecompiledRunner::Invalidate(U16 address, U16 length) {
+	//LoadRom rewrites all of memory
+	if (length >= sizeof(m_Chip.m_Memory)) {
+		m_Match = true;
+		return;
+	}
+
+	if (m_Rom == nullptr)
+		return;
+
+	//Called after the write, a block whose bytes match the image again, like after LoadState, runs natively again
+	for (int i = 0; i < m_Rom->blockCount; i++) {
+		int start = m_Rom->blocks[i][0];
+		int end = m_Rom->blocks[i][1];
+		if (address < end && address + length > start) {
+			bool inImage = start >= 0x200 && end - 0x200 <= m_Rom->imageSize;
+			m_Modified[start] = !inImage || memcmp(m_Chip.m_Memory + start, m_Rom->image + start - 0x200, end - start) != 0;
+		}
+	}
+}
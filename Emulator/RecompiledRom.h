@@ -0,0 +1,53 @@
+#pragma once
+#include "SuperChip.h"
+
+//Native code for a SuperChip rom, written by the Recompiler. Runs from chip.m_RegPC until an instruction raises one of
+//stopEvents or maxCycles instructions have run, stores how many ran in executed and returns the RunEvent flags. Blocks
+//with modified[start] set and addresses without native code run on the interpreter.
+typedef U32(*RecompiledFunction)(SuperChip& chip, const U8* modified, U32 stopEvents, int maxCycles, int* executed);
+
+struct RecompiledRom {
+	const char* name;
+	//Rom bytes the code was recovered from, loaded at 0x200
+	const U8* image;
+	int imageSize;
+	//Start and end address of every native block
+	const U16(*blocks)[2];
+	int blockCount;
+	RecompiledFunction run;
+	RecompiledRom* next;
+};
+
+//Adds a rom to the list searched by RecompiledRunner, generated files register themselves with a static instance
+struct RecompiledRomRegistrar {
+	RecompiledRomRegistrar(RecompiledRom& rom);
+};
+
+RecompiledRom* FirstRecompiledRom();
+
+//Runs the loaded rom through its recompiled code when one of the registered images matches memory,
+//and through SuperChip::RunCycles otherwise.
+struct RecompiledRunner {
+	SuperChip& m_Chip;
+	RecompiledRom* m_Rom;
+	//Set by LoadRom, the rom in memory is looked up again before the next run
+	bool m_Match;
+	//Blocks whose code differs from the image, indexed by start address
+	U8 m_Modified[4096];
+
+	RecompiledRunner(SuperChip& chip);
+	~RecompiledRunner();
+
+	//Executes cycles instructions and returns the RunEvent flags like SuperChip::RunCycles
+	U32 Run(int cycles);
+	//Runs until an instruction raises one of stopEvents or maxCycles instructions have run, like SuperChip::RunUntil.
+	//FX18 always runs on the interpreter, so the sound events stop the run right after it.
+	U32 RunUntil(U32 stopEvents, int maxCycles, int* executed = nullptr);
+
+private:
+	RecompiledRunner(const RecompiledRunner&);
+	RecompiledRunner& operator=(const RecompiledRunner&);
+
+	void Match();
+	void Invalidate(U16 address, U16 length);
+};
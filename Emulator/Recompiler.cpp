@@ -0,0 +1,457 @@
+#include "Recompiler.h"
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "SuperChip.h"
+
+using namespace std;
+
+namespace {
+
+//Writes one printf formatted line
+void Line(ostream& out, const char* format, ...) {
+	char buffer[256];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	out << buffer << "\n";
+}
+
+bool IsSkip(U8 handler) {
+	switch (handler) {
+		case OP_3XNN:
+		case OP_4XNN:
+		case OP_5XY0:
+		case OP_9XY0:
+		case OP_EX9E:
+		case OP_EXA1:
+			return true;
+		default:
+			return false;
+	}
+}
+
+//Opcodes after which execution does not continue with the next instruction
+bool EndsBlock(U8 handler) {
+	switch (handler) {
+		case OP_00EE:
+		case OP_1NNN:
+		case OP_2NNN:
+		case OP_BNNN:
+			return true;
+		default:
+			return IsSkip(handler);
+	}
+}
+
+}
+
+Recompiler::Recompiler() : m_RomEnd(ROM_START) {
+	memset(m_Memory, 0, sizeof(m_Memory));
+	memset(m_IsCode, 0, sizeof(m_IsCode));
+	memset(m_IsLeader, 0, sizeof(m_IsLeader));
+	memset(m_IsReferenced, 0, sizeof(m_IsReferenced));
+}
+
+bool Recompiler::Recompile(const char* romPath, const char* outputPath) {
+	if (!LoadRom(romPath)) {
+		cout << "File " << romPath << " not found." << endl;
+		return false;
+	}
+
+	Recover();
+
+	ofstream out(outputPath);
+	if (!out.is_open()) {
+		cout << "File " << outputPath << " could not be written." << endl;
+		return false;
+	}
+
+	//Name the rom after its file
+	string name = romPath;
+	size_t slash = name.find_last_of("/\\");
+	if (slash != string::npos)
+		name = name.substr(slash + 1);
+	for (size_t i = 0; i < name.size(); i++) {
+		if (name[i] == '"' || name[i] == '\\')
+			name[i] = '_';
+	}
+
+	Write(out, name);
+	return true;
+}
+
+bool Recompiler::LoadRom(const char* romPath) {
+	ifstream file(romPath, ios::in | ios::binary | ios::ate);
+	if (!file.is_open())
+		return false;
+
+	streamoff size = file.tellg();
+	if (size > (streamoff)sizeof(m_Memory) - ROM_START)
+		size = sizeof(m_Memory) - ROM_START;
+
+	file.seekg(0, ios::beg);
+	file.read((char*)m_Memory + ROM_START, size);
+	m_RomEnd = ROM_START + (int)size;
+	return true;
+}
+
+DecodedOp Recompiler::Decode(U16 address) const {
+	return DecodeOpCode((m_Memory[address] << 8) | m_Memory[address + 1], true);
+}
+
+bool Recompiler::IsDelegated(U16 address, const DecodedOp& op) const {
+	switch (op.handler) {
+		case OP_00CN:
+		case OP_00E0:
+		case OP_00FB:
+		case OP_00FC:
+		case OP_00FD:
+		case OP_00FE:
+		case OP_00FF:
+		case OP_DXYN:
+		case OP_FX0A:
+		case OP_FX18:
+		case OP_FX33:
+		case OP_FX55:
+		case OP_FX75:
+		case OP_FX85:
+			return true;
+		case OP_1NNN:
+			//The interpreter skips delay timer spins
+			return IsDelaySpin(m_Memory, address);
+		default:
+			return false;
+	}
+}
+
+void Recompiler::Recover() {
+	vector<U16> pending;
+	auto addEntry = [&](int address) {
+		if (IsInRom(address)) {
+			m_IsLeader[address] = true;
+			pending.push_back((U16)address);
+		}
+	};
+
+	addEntry(ROM_START);
+	while (!pending.empty()) {
+		U16 address = pending.back();
+		pending.pop_back();
+
+		//Follow the code until it branches or reaches an instruction that was already recovered
+		while (IsInRom(address) && !m_IsCode[address]) {
+			DecodedOp op = Decode(address);
+			//Unknown opcodes are most likely data
+			if (op.handler == OP_NOP)
+				break;
+
+			m_IsCode[address] = true;
+			U16 next = address + 2;
+
+			if (IsDelegated(address, op)) {
+				m_IsLeader[address] = true;
+				if (IsInRom(next))
+					m_IsLeader[next] = true;
+			}
+
+			if (op.handler == OP_1NNN) {
+				addEntry(op.nnn);
+			} else if (op.handler == OP_2NNN) {
+				addEntry(op.nnn);
+				addEntry(next);
+			} else if (op.handler == OP_BNNN) {
+				//The target depends on a register. Recover the jump table that usually starts at NNN,
+				//any other target goes through the dispatcher.
+				for (U16 entry = op.nnn; IsInRom(entry) && Decode(entry).handler == OP_1NNN; entry += 2) {
+					addEntry(entry);
+				}
+			} else if (IsSkip(op.handler)) {
+				addEntry(next);
+				addEntry(next + 2);
+			}
+
+			if (EndsBlock(op.handler))
+				break;
+			address = next;
+		}
+	}
+}
+
+void Recompiler::Write(ostream& out, const string& name) {
+	//The first pass only finds the blocks that are jumped to, so that unused labels are left out
+	ostringstream discard;
+	WriteBlocks(discard);
+
+	Line(out, "//Generated by Emulator -recompile from %s, do not edit.", name.c_str());
+	Line(out, "#include <cstdlib>");
+	Line(out, "#include <cstring>");
+	Line(out, "");
+	Line(out, "#include \"RecompiledRom.h\"");
+	Line(out, "");
+	Line(out, "namespace {");
+	Line(out, "");
+
+	Line(out, "const U8 gImage[] = {");
+	for (int address = ROM_START; address < m_RomEnd; address += 16) {
+		ostringstream row;
+		row << "\t";
+		for (int i = address; i < address + 16 && i < m_RomEnd; i++) {
+			char byte[8];
+			snprintf(byte, sizeof(byte), "0x%02X,", m_Memory[i]);
+			row << (i == address ? "" : " ") << byte;
+		}
+		Line(out, "%s", row.str().c_str());
+	}
+	Line(out, "};");
+	Line(out, "");
+
+	Line(out, "const U16 gBlocks[][2] = {");
+	int blockCount = 0;
+	for (int address = ROM_START; address < m_RomEnd; address++) {
+		if (m_IsLeader[address] && m_IsCode[address] && !IsDelegated((U16)address, Decode((U16)address))) {
+			Line(out, "\t{ 0x%03X, 0x%03X },", address, BlockEnd((U16)address));
+			blockCount++;
+		}
+	}
+	if (blockCount == 0)
+		Line(out, "\t{ 0x000, 0x000 },");
+	Line(out, "};");
+	Line(out, "");
+
+	Line(out, "U32 Run(SuperChip& chip, const U8* modified, U32 stopEvents, int maxCycles, int* executed) {");
+	Line(out, "\tU32 events = 0;");
+	Line(out, "\tint cycles = maxCycles;");
+	Line(out, "\tU8 V[16];");
+	Line(out, "\tU16 I;");
+	Line(out, "");
+	Line(out, "\twhile (cycles > 0 && (events & stopEvents) == 0) {");
+	Line(out, "\t\tmemcpy(V, chip.m_Reg, sizeof(V));");
+	Line(out, "\t\tI = chip.m_RegI;");
+	Line(out, "\t\tbool interpret = true;");
+	Line(out, "");
+	Line(out, "\t\tswitch (chip.m_RegPC) {");
+	WriteBlocks(out);
+	Line(out, "\t\t\tdefault:");
+	Line(out, "\t\t\t\tbreak;");
+	Line(out, "\t\t}");
+	Line(out, "");
+	Line(out, "\t\tmemcpy(chip.m_Reg, V, sizeof(V));");
+	Line(out, "\t\tchip.m_RegI = I;");
+	Line(out, "");
+	Line(out, "\t\t//Everything without native code runs on the interpreter");
+	Line(out, "\t\tif (interpret && cycles > 0) {");
+	Line(out, "\t\t\tU32 step = chip.RunCycles(1);");
+	Line(out, "\t\t\tevents |= step;");
+	Line(out, "\t\t\tcycles--;");
+	Line(out, "");
+	Line(out, "\t\t\t//The rom is waiting, let the interpreter skip the rest of the budget");
+	Line(out, "\t\t\tif ((step & EVENT_IDLE) != 0 && cycles > 0 && (events & stopEvents) == 0) {");
+	Line(out, "\t\t\t\tint skipped = 0;");
+	Line(out, "\t\t\t\tevents |= chip.RunUntil(stopEvents, cycles, &skipped);");
+	Line(out, "\t\t\t\tcycles -= skipped;");
+	Line(out, "\t\t\t}");
+	Line(out, "\t\t}");
+	Line(out, "\t}");
+	Line(out, "");
+	Line(out, "\t*executed = maxCycles - cycles;");
+	Line(out, "\treturn events;");
+	Line(out, "}");
+	Line(out, "");
+
+	Line(out, "RecompiledRom gRom = { \"%s\", gImage, sizeof(gImage), gBlocks, %d, Run, nullptr };", name.c_str(), blockCount);
+	Line(out, "RecompiledRomRegistrar gRegistrar(gRom);");
+	Line(out, "");
+	Line(out, "}");
+}
+
+void Recompiler::WriteBlocks(ostream& out) {
+	for (int address = ROM_START; address < m_RomEnd; address++) {
+		if (m_IsLeader[address] && m_IsCode[address])
+			WriteBlock(out, (U16)address);
+	}
+}
+
+U16 Recompiler::BlockEnd(U16 start) const {
+	U16 address = start;
+	for (;;) {
+		U16 next = address + 2;
+		if (EndsBlock(Decode(address).handler) || !IsInRom(next) || !m_IsCode[next] || m_IsLeader[next])
+			return next;
+		address = next;
+	}
+}
+
+void Recompiler::WriteBlock(ostream& out, U16 start) {
+	if (m_IsReferenced[start])
+		Line(out, "\t\t\tcase 0x%03X: L%03X:", start, start);
+	else
+		Line(out, "\t\t\tcase 0x%03X:", start);
+
+	DecodedOp first = Decode(start);
+	if (IsDelegated(start, first)) {
+		Line(out, "\t\t\t\t//%02X%02X runs on the interpreter", m_Memory[start], m_Memory[start + 1]);
+		Line(out, "\t\t\t\tchip.m_RegPC = 0x%03X;", start);
+		Line(out, "\t\t\t\tbreak;");
+		return;
+	}
+
+	//The whole block has to fit in the budget, otherwise it is stepped through by the interpreter
+	U16 end = BlockEnd(start);
+	int count = (end - start) / 2;
+	Line(out, "\t\t\t\tif (cycles < %d || modified[0x%03X]) {", count, start);
+	Line(out, "\t\t\t\t\tchip.m_RegPC = 0x%03X;", start);
+	Line(out, "\t\t\t\t\tbreak;");
+	Line(out, "\t\t\t\t}");
+	Line(out, "\t\t\t\tcycles -= %d;", count);
+
+	for (U16 address = start; address < end; address += 2) {
+		WriteInstruction(out, address, Decode(address));
+	}
+
+	if (!EndsBlock(Decode(end - 2).handler))
+		WriteTarget(out, end, "\t\t\t\t");
+}
+
+void Recompiler::WriteInstruction(ostream& out, U16 address, const DecodedOp& op) {
+	const char* in = "\t\t\t\t";
+	U16 next = address + 2;
+
+	Line(out, "%s//%02X%02X", in, m_Memory[address], m_Memory[address + 1]);
+	switch (op.handler) {
+		case OP_00EE:
+			Line(out, "%schip.m_RegPC = chip.m_Stack[--chip.m_StackPointer];", in);
+			Line(out, "%sinterpret = false;", in);
+			Line(out, "%sbreak;", in);
+			break;
+		case OP_1NNN:
+			WriteTarget(out, op.nnn, in);
+			break;
+		case OP_2NNN:
+			Line(out, "%schip.m_Stack[chip.m_StackPointer++] = 0x%03X;", in, next);
+			WriteTarget(out, op.nnn, in);
+			break;
+		case OP_3XNN:
+		case OP_4XNN:
+		case OP_5XY0:
+		case OP_9XY0:
+		case OP_EX9E:
+		case OP_EXA1:
+			switch (op.handler) {
+				case OP_3XNN: Line(out, "%sif (V[0x%X] == 0x%02X) {", in, op.x, op.nn); break;
+				case OP_4XNN: Line(out, "%sif (V[0x%X] != 0x%02X) {", in, op.x, op.nn); break;
+				case OP_5XY0: Line(out, "%sif (V[0x%X] == V[0x%X]) {", in, op.x, op.y); break;
+				case OP_9XY0: Line(out, "%sif (V[0x%X] != V[0x%X]) {", in, op.x, op.y); break;
+				case OP_EX9E: Line(out, "%sif (((chip.m_Key >> V[0x%X]) & 1) != 0) {", in, op.x); break;
+				default: Line(out, "%sif (((chip.m_Key >> V[0x%X]) & 1) == 0) {", in, op.x); break;
+			}
+			WriteTarget(out, next + 2, "\t\t\t\t\t");
+			Line(out, "%s}", in);
+			WriteTarget(out, next, in);
+			break;
+		case OP_6XNN:
+			Line(out, "%sV[0x%X] = 0x%02X;", in, op.x, op.nn);
+			break;
+		case OP_7XNN:
+			Line(out, "%sV[0x%X] += 0x%02X;", in, op.x, op.nn);
+			break;
+		case OP_8XY0:
+			Line(out, "%sV[0x%X] = V[0x%X];", in, op.x, op.y);
+			break;
+		case OP_8XY1:
+			Line(out, "%sV[0x%X] |= V[0x%X];", in, op.x, op.y);
+			break;
+		case OP_8XY2:
+			Line(out, "%sV[0x%X] &= V[0x%X];", in, op.x, op.y);
+			break;
+		case OP_8XY3:
+			Line(out, "%sV[0x%X] ^= V[0x%X];", in, op.x, op.y);
+			break;
+		case OP_8XY4:
+			//Same statements as the interpreter, X or Y may be VF
+			Line(out, "%sV[0x%X] += V[0x%X];", in, op.x, op.y);
+			Line(out, "%sV[0xF] = 0;", in);
+			Line(out, "%sif (V[0x%X] > (0xFF - V[0x%X])) {", in, op.y, op.x);
+			Line(out, "%s\tV[0xF] = 1;", in);
+			Line(out, "%s}", in);
+			break;
+		case OP_8XY5:
+			Line(out, "%sV[0x%X] -= V[0x%X];", in, op.x, op.y);
+			Line(out, "%sV[0xF] = 1;", in);
+			Line(out, "%sif (V[0x%X] > (0xFF - V[0x%X])) {", in, op.y, op.x);
+			Line(out, "%s\tV[0xF] = 0;", in);
+			Line(out, "%s}", in);
+			break;
+		case OP_8XY6:
+			if (SuperChipPolicy::SHIFT_VY)
+				Line(out, "%sV[0x%X] = V[0x%X];", in, op.x, op.y);
+			Line(out, "%sV[0xF] = V[0x%X] & 1;", in, op.x);
+			Line(out, "%sV[0x%X] = V[0x%X] >> 1;", in, op.x, op.x);
+			break;
+		case OP_8XY7:
+			Line(out, "%sV[0x%X] = V[0x%X] - V[0x%X];", in, op.x, op.y, op.x);
+			Line(out, "%sV[0xF] = 1;", in);
+			Line(out, "%sif (V[0x%X] < V[0x%X]) {", in, op.y, op.x);
+			Line(out, "%s\tV[0xF] = 0;", in);
+			Line(out, "%s}", in);
+			break;
+		case OP_8XYE:
+			if (SuperChipPolicy::SHIFT_VY)
+				Line(out, "%sV[0x%X] = V[0x%X];", in, op.x, op.y);
+			Line(out, "%sV[0xF] = V[0x%X] >> 7;", in, op.x);
+			Line(out, "%sV[0x%X] = V[0x%X] << 1;", in, op.x, op.x);
+			break;
+		case OP_ANNN:
+			Line(out, "%sI = 0x%03X;", in, op.nnn);
+			break;
+		case OP_BNNN:
+			Line(out, "%schip.m_RegPC = 0x%03X + V[0x%X];", in, op.nnn, SuperChipPolicy::JUMP_VX ? op.x : 0);
+			Line(out, "%sinterpret = false;", in);
+			Line(out, "%sbreak;", in);
+			break;
+		case OP_CXNN:
+			Line(out, "%sV[0x%X] = (chip.NextRandom() %% 0xFF) & 0x%02X;", in, op.x, op.nn);
+			break;
+		case OP_FX07:
+			Line(out, "%sV[0x%X] = chip.m_TimerDelay;", in, op.x);
+			break;
+		case OP_FX15:
+			Line(out, "%schip.m_TimerDelay = V[0x%X];", in, op.x);
+			break;
+		case OP_FX1E:
+			Line(out, "%sI += V[0x%X];", in, op.x);
+			Line(out, "%sV[0xF] = I > 0xFFF ? 1 : 0;", in);
+			break;
+		case OP_FX29:
+			Line(out, "%sI = V[0x%X] * 5;", in, op.x);
+			break;
+		case OP_FX30:
+			Line(out, "%sI = V[0x%X] * 10 + SuperChip::SUPERFONT_START;", in, op.x);
+			break;
+		case OP_FX65:
+			for (int i = 0; i <= op.x; i++) {
+				Line(out, "%sV[0x%X] = chip.m_Memory[I + %d];", in, i, i);
+			}
+			if (SuperChipPolicy::LOAD_STORE_INCREMENTS_I)
+				Line(out, "%sI += %d;", in, op.x + 1);
+			break;
+		default:
+			break;
+	}
+}
+
+void Recompiler::WriteTarget(ostream& out, U16 target, const char* indent) {
+	if (IsInRom(target) && m_IsCode[target] && m_IsLeader[target]) {
+		m_IsReferenced[target] = true;
+		Line(out, "%sgoto L%03X;", indent, target);
+	} else {
+		Line(out, "%schip.m_RegPC = 0x%03X;", indent, target);
+		Line(out, "%sbreak;", indent);
+	}
+}
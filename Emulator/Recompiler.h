@@ -0,0 +1,44 @@
+#pragma once
+#include <ostream>
+#include <string>
+
+#include "OpCode.h"
+
+//Static recompiler, turns a SuperChip rom into a C++ translation unit that registers itself for RecompiledRunner.
+//Run "Emulator -recompile <rom> <output.cpp>" and add the output to the project.
+//
+//Code is recovered by following every path from 0x200: 1NNN and 2NNN targets, return addresses, both sides of the
+//skips and the 1NNN entries of BNNN jump tables. Display opcodes, FX0A and the opcodes that write memory are left to
+//the interpreter, and so is every address that was not recovered.
+struct Recompiler {
+	static const U16 ROM_START = 0x200;
+
+	U8 m_Memory[4096];
+	int m_RomEnd;
+	bool m_IsCode[4096];
+	//Instruction where native code can be entered, from the dispatcher or by a goto
+	bool m_IsLeader[4096];
+	bool m_IsReferenced[4096];
+
+	Recompiler();
+
+	//Writes the translation unit for the rom at romPath to outputPath
+	bool Recompile(const char* romPath, const char* outputPath);
+
+private:
+	bool LoadRom(const char* romPath);
+	void Recover();
+	void Write(std::ostream& out, const std::string& name);
+	void WriteBlocks(std::ostream& out);
+	void WriteBlock(std::ostream& out, U16 start);
+	void WriteInstruction(std::ostream& out, U16 address, const DecodedOp& op);
+	//Continues at target, natively when a block starts there and through the interpreter otherwise
+	void WriteTarget(std::ostream& out, U16 target, const char* indent);
+
+	DecodedOp Decode(U16 address) const;
+	//Address after the last instruction of the block that starts at start
+	U16 BlockEnd(U16 start) const;
+	bool IsInRom(int address) const { return address >= ROM_START && address + 1 < m_RomEnd; }
+	//Instructions the generated code leaves to the interpreter
+	bool IsDelegated(U16 address, const DecodedOp& op) const;
+};
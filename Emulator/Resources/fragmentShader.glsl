@@ -1,7 +1,13 @@
 #version 330 core
 in vec2 UV;
 out vec4 color;
-uniform sampler2D texSampler;
+//The display plane, a byte of 8 pixels per texel. Each 64 pixels are a little endian 64 bit word with the first
+//pixel in its top bit.
+uniform usampler2D texSampler;
+//Size of the active display in pixels, it fills the top left corner of the texture
+uniform vec2 displaySize;
+uniform vec3 onColor;
+uniform vec3 offColor;
 
 float distortion = 0.2f;
 
@@ -16,11 +22,22 @@ vec2 BarrelDistort(vec2 uv){
 	return newUV;
 }
 
+vec4 SampleDisplay(vec2 uv){
+	//Past the right or bottom edge, black like the border of a texture of the display size
+	vec2 texel = uv * displaySize;
+	if (any(greaterThanEqual(texel, displaySize)))
+		return vec4(0);
+	ivec2 pixel = ivec2(texel);
+	int x = pixel.x % 64;
+	uint bits = texelFetch(texSampler, ivec2(pixel.x / 64 * 8 + 7 - x / 8, pixel.y), 0).r;
+	return ((bits >> uint(7 - x % 8)) & 1u) != 0u ? vec4(onColor, 1) : vec4(offColor, 1);
+}
+
 void main() {
 	vec2 newUV = BarrelDistort(UV);
 	//newUV = UV;
 
-	color = texture(texSampler, newUV);
+	color = SampleDisplay(newUV);
 	color = (color / 1.2f) + 0.15f;
 	color *= 0.1f * sin(newUV.y * 32 * 40) * 2 + 0.9f;
 	color *= clamp((pow(sin(newUV.x * 3.1415f) * sin(newUV.y * 3.1415f) , 0.25f)), 0, 1);
@@ -0,0 +1,92 @@
+#include "Scheduler.h"
+#include <thread>
+
+//Largest change of the tick rate on the audio clock to reach the target fill, small enough not to be heard as pitch
+static const double MAX_RATE_ADJUST = 0.005;
+
+Scheduler::Scheduler(U32 instructionsPerSecond) {
+	m_InstructionsPerSecond = instructionsPerSecond;
+	m_Remainder = 0;
+	m_Turbo = false;
+	m_Audio = nullptr;
+	m_TargetFill = 0;
+	Restart();
+}
+
+void Scheduler::SetTurbo(bool turbo) {
+	if (m_Turbo && !turbo)
+		Restart();
+	m_Turbo = turbo;
+}
+
+int Scheduler::NextTickInstructions() {
+	m_Remainder += m_InstructionsPerSecond;
+	int instructions = m_Remainder / TICK_RATE;
+	m_Remainder %= TICK_RATE;
+	return instructions;
+}
+
+int Scheduler::PeekTickInstructions(int ticks) const {
+	U64 before = m_Remainder + (U64)m_InstructionsPerSecond * ticks;
+	return (int)((before + m_InstructionsPerSecond) / TICK_RATE - before / TICK_RATE);
+}
+
+void Scheduler::WaitForTick() {
+	m_Tick++;
+	if (m_Turbo)
+		return;
+	if (m_Audio != nullptr) {
+		WaitForAudio();
+		return;
+	}
+
+	std::chrono::steady_clock::time_point due = m_Start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(m_Tick * 1000000000 / TICK_RATE));
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now - due > std::chrono::nanoseconds((U64)MAX_LATE_TICKS * 1000000000 / TICK_RATE)) {
+		//A long stall such as a breakpoint or a suspended machine, continue from now instead of running it all at once
+		Restart();
+		return;
+	}
+	std::this_thread::sleep_until(due);
+}
+
+void Scheduler::Restart() {
+	m_Start = std::chrono::steady_clock::now();
+	m_Tick = 0;
+	//Run at once what the ring lacks of its target, or wait for it to drain to there
+	if (m_Audio != nullptr) {
+		m_Played = m_Audio->Played();
+		m_Credit = (double)m_TargetFill - m_Audio->Queued();
+	}
+}
+
+void Scheduler::SetAudioClock(const Beeper* beeper, U32 targetFill) {
+	m_Audio = beeper;
+	m_TargetFill = targetFill;
+	Restart();
+}
+
+void Scheduler::WaitForAudio() {
+	const int TICK_SAMPLES = Beeper::TICK_SAMPLES;
+	for (;;) {
+		U32 played = m_Audio->Played();
+		double error = ((double)m_TargetFill - m_Audio->Queued()) / m_TargetFill;
+		if (error > 1)
+			error = 1;
+		else if (error < -1)
+			error = -1;
+		m_Credit += (played - m_Played) * (1 + MAX_RATE_ADJUST * error);
+		m_Played = played;
+
+		if (m_Credit > (double)MAX_LATE_TICKS * TICK_SAMPLES) {
+			//The same as a long stall of the monotonic clock, refill the ring instead of running it all at once
+			Restart();
+		}
+		if (m_Credit >= TICK_SAMPLES) {
+			m_Credit -= TICK_SAMPLES;
+			return;
+		}
+		//Until the output should have played the rest of the tick
+		std::this_thread::sleep_for(std::chrono::microseconds((long long)((TICK_SAMPLES - m_Credit) * 1000000 / Beeper::SAMPLE_RATE) + 1));
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <chrono>
+
+#include "OpCode.h"
+#include "Beeper.h"
+
+//Paces the emulator in ticks of the 60 Hz timers, from the monotonic clock and independent of the display. Each tick
+//decreases the timers once and runs the share of the instruction budget that falls into it, a rate that is not a
+//multiple of 60 is spread evenly over the ticks. Turbo mode runs the ticks as fast as the host can.
+//
+//With an audio clock the ticks follow the samples the audio output played instead, a tick is due each time it took
+//another tick of samples. The sound then never runs dry or piles up when the output's clock drifts from the host's.
+//Counting the samples alone keeps whatever the ring held at the start, so the rate is also nudged by up to
+//0.5% to bring the ring to its target fill: the emulator runs a little faster while the ring is below it.
+//
+//	for (;;) {
+//		emulator.DecreaseTimers();
+//		emulator.RunCycles(scheduler.NextTickInstructions());
+//		scheduler.WaitForTick();
+//	}
+struct Scheduler {
+	static const int TICK_RATE = 60;
+	//Ticks that may run back to back to catch up, when further behind the missed time is dropped
+	static const int MAX_LATE_TICKS = 4;
+
+	U32 m_InstructionsPerSecond;
+	//Instructions owed to the next ticks, in 1/60 instructions
+	U32 m_Remainder;
+	bool m_Turbo;
+	//Tick n is due at m_Start + n / 60 seconds, computed from n so that no rounding adds up
+	std::chrono::steady_clock::time_point m_Start;
+	U64 m_Tick;
+
+	//The audio clock, nullptr to pace from the monotonic clock
+	const Beeper* m_Audio;
+	U32 m_TargetFill;
+	//Beeper::Played when last looked at
+	U32 m_Played;
+	//Samples played that no tick was run for yet, a tick is due at TICK_SAMPLES
+	double m_Credit;
+
+	Scheduler(U32 instructionsPerSecond = 300);
+
+	void SetInstructionsPerSecond(U32 instructionsPerSecond) { m_InstructionsPerSecond = instructionsPerSecond; }
+	U32 InstructionsPerSecond() const { return m_InstructionsPerSecond; }
+	//Leaving turbo mode starts pacing again from the current time
+	void SetTurbo(bool turbo);
+	bool Turbo() const { return m_Turbo; }
+
+	int NextTickInstructions();
+	//What NextTickInstructions will return ticks calls from now, 0 being the next call
+	int PeekTickInstructions(int ticks) const;
+	//Sleeps until the next tick is due, returns at once in turbo mode or when behind
+	void WaitForTick();
+	//Starts pacing from the current time
+	void Restart();
+
+	//Paces from the samples beeper's output plays, keeping targetFill samples queued. nullptr goes back to the
+	//monotonic clock.
+	void SetAudioClock(const Beeper* beeper, U32 targetFill);
+
+private:
+	void WaitForAudio();
+};
@@ -0,0 +1,276 @@
+#include "Scroll.h"
+#include <cstring>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define SCROLL_SIMD_ENABLED
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+//MSVC compiles AVX2 intrinsics without /arch:AVX2, GCC and Clang need the target on every function that uses them
+#define SCROLL_AVX2_TARGET
+#else
+#define SCROLL_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+bool CpuHasAvx2() {
+#if !defined(SCROLL_SIMD_ENABLED)
+	return false;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return false;
+	}
+	//AVX needs OSXSAVE and the OS saving the YMM registers
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6) {
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+ScrollPath BestScrollPath() {
+#if defined(SCROLL_SIMD_ENABLED)
+	static const ScrollPath best = CpuHasAvx2() ? SCROLL_AVX2 : SCROLL_SSE2;
+	return best;
+#else
+	return SCROLL_SCALAR;
+#endif
+}
+
+static ScrollPath gScrollPath = BestScrollPath();
+
+ScrollPath GetScrollPath() {
+	return gScrollPath;
+}
+
+void SetScrollPath(ScrollPath path) {
+	gScrollPath = path <= BestScrollPath() ? path : BestScrollPath();
+}
+
+//Scalar kernels, also the fallback for layouts the SIMD kernels do not handle
+
+static void PlaneRight4Scalar(U64* plane, int stride, int words, int height) {
+	for (int y = 0; y < height; y++) {
+		U64* row = plane + y * stride;
+		for (int i = words - 1; i > 0; i--) {
+			row[i] = (row[i] >> 4) | (row[i - 1] << 60);
+		}
+		row[0] >>= 4;
+	}
+}
+
+static void PlaneLeft4Scalar(U64* plane, int stride, int words, int height) {
+	for (int y = 0; y < height; y++) {
+		U64* row = plane + y * stride;
+		for (int i = 0; i < words - 1; i++) {
+			row[i] = (row[i] << 4) | (row[i + 1] >> 60);
+		}
+		row[words - 1] <<= 4;
+	}
+}
+
+static void RGBARight4Scalar(U32* row, int width, U32 clear) {
+	for (int x = width - 1; x >= 4; x--) {
+		row[x] = row[x - 4];
+	}
+	for (int x = 0; x < 4 && x < width; x++) {
+		row[x] = clear;
+	}
+}
+
+static void RGBALeft4Scalar(U32* row, int width, U32 clear) {
+	for (int x = 0; x < width - 4; x++) {
+		row[x] = row[x + 4];
+	}
+	for (int x = width < 4 ? 0 : width - 4; x < width; x++) {
+		row[x] = clear;
+	}
+}
+
+#if defined(SCROLL_SIMD_ENABLED)
+
+//A two word row in one register, word 0 in the low lane. Its high bits are the leftmost pixels, so moving pixels
+//right shifts each word right and carries the low 4 bits of word 0 into the top of word 1.
+
+static void PlaneRight4Sse2(U64* plane, int stride, int height) {
+	for (int y = 0; y < height; y++) {
+		__m128i* row = reinterpret_cast<__m128i*>(plane + y * stride);
+		__m128i v = _mm_loadu_si128(row);
+		__m128i carry = _mm_slli_si128(_mm_slli_epi64(v, 60), 8);
+		_mm_storeu_si128(row, _mm_or_si128(_mm_srli_epi64(v, 4), carry));
+	}
+}
+
+static void PlaneLeft4Sse2(U64* plane, int stride, int height) {
+	for (int y = 0; y < height; y++) {
+		__m128i* row = reinterpret_cast<__m128i*>(plane + y * stride);
+		__m128i v = _mm_loadu_si128(row);
+		__m128i carry = _mm_srli_si128(_mm_srli_epi64(v, 60), 8);
+		_mm_storeu_si128(row, _mm_or_si128(_mm_slli_epi64(v, 4), carry));
+	}
+}
+
+//Byte shifts stay inside each 128 bit lane, so two adjacent rows move at once when the rows are packed
+SCROLL_AVX2_TARGET static void PlaneRight4Avx2(U64* plane, int height) {
+	int y = 0;
+	for (; y + 2 <= height; y += 2) {
+		__m256i* rows = reinterpret_cast<__m256i*>(plane + y * 2);
+		__m256i v = _mm256_loadu_si256(rows);
+		__m256i carry = _mm256_slli_si256(_mm256_slli_epi64(v, 60), 8);
+		_mm256_storeu_si256(rows, _mm256_or_si256(_mm256_srli_epi64(v, 4), carry));
+	}
+	PlaneRight4Sse2(plane + y * 2, 2, height - y);
+}
+
+SCROLL_AVX2_TARGET static void PlaneLeft4Avx2(U64* plane, int height) {
+	int y = 0;
+	for (; y + 2 <= height; y += 2) {
+		__m256i* rows = reinterpret_cast<__m256i*>(plane + y * 2);
+		__m256i v = _mm256_loadu_si256(rows);
+		__m256i carry = _mm256_srli_si256(_mm256_srli_epi64(v, 60), 8);
+		_mm256_storeu_si256(rows, _mm256_or_si256(_mm256_slli_epi64(v, 4), carry));
+	}
+	PlaneLeft4Sse2(plane + y * 2, 2, height - y);
+}
+
+//Moving right works from the end of the row, so every load is below everything stored so far. Unrolling these
+//loops made them slower, they are bound by the stores.
+
+static void RGBARight4Sse2(U32* row, int width, U32 clear) {
+	int x = width - 4;
+	for (; x >= 4; x -= 4) {
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(row + x), _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x - 4)));
+	}
+	RGBARight4Scalar(row, x + 4, clear);
+}
+
+static void RGBALeft4Sse2(U32* row, int width, U32 clear) {
+	int x = 0;
+	for (; x + 8 <= width; x += 4) {
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(row + x), _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x + 4)));
+	}
+	RGBALeft4Scalar(row + x, width - x, clear);
+}
+
+SCROLL_AVX2_TARGET static void RGBARight4Avx2(U32* row, int width, U32 clear) {
+	int x = width - 8;
+	for (; x >= 4; x -= 8) {
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(row + x), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x - 4)));
+	}
+	RGBARight4Sse2(row, x + 8, clear);
+}
+
+SCROLL_AVX2_TARGET static void RGBALeft4Avx2(U32* row, int width, U32 clear) {
+	int x = 0;
+	for (; x + 12 <= width; x += 8) {
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(row + x), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x + 4)));
+	}
+	RGBALeft4Sse2(row + x, width - x, clear);
+}
+
+#endif
+
+//Down scrolls move whole rows, memmove already copies them with the widest stores the CPU has
+
+void ScrollPlaneDown(U64* plane, int stride, int words, int height, int lines) {
+	if (lines <= 0) {
+		return;
+	}
+	if (lines > height) {
+		lines = height;
+	}
+	if (stride == words) {
+		memmove(plane + lines * stride, plane, (height - lines) * stride * sizeof(U64));
+		memset(plane, 0, lines * stride * sizeof(U64));
+		return;
+	}
+	for (int y = height - 1; y >= lines; y--) {
+		memcpy(plane + y * stride, plane + (y - lines) * stride, words * sizeof(U64));
+	}
+	for (int y = 0; y < lines; y++) {
+		memset(plane + y * stride, 0, words * sizeof(U64));
+	}
+}
+
+void ScrollPlaneRight4(U64* plane, int stride, int words, int height) {
+#if defined(SCROLL_SIMD_ENABLED)
+	if (words == 2 && gScrollPath != SCROLL_SCALAR) {
+		if (gScrollPath == SCROLL_AVX2 && stride == 2) {
+			PlaneRight4Avx2(plane, height);
+		} else {
+			PlaneRight4Sse2(plane, stride, height);
+		}
+		return;
+	}
+#endif
+	PlaneRight4Scalar(plane, stride, words, height);
+}
+
+void ScrollPlaneLeft4(U64* plane, int stride, int words, int height) {
+#if defined(SCROLL_SIMD_ENABLED)
+	if (words == 2 && gScrollPath != SCROLL_SCALAR) {
+		if (gScrollPath == SCROLL_AVX2 && stride == 2) {
+			PlaneLeft4Avx2(plane, height);
+		} else {
+			PlaneLeft4Sse2(plane, stride, height);
+		}
+		return;
+	}
+#endif
+	PlaneLeft4Scalar(plane, stride, words, height);
+}
+
+void ScrollRGBADown(U32* pixels, int width, int height, int lines, U32 clear) {
+	if (lines <= 0) {
+		return;
+	}
+	if (lines > height) {
+		lines = height;
+	}
+	memmove(pixels + lines * width, pixels, (height - lines) * width * sizeof(U32));
+	for (int i = 0; i < lines * width; i++) {
+		pixels[i] = clear;
+	}
+}
+
+void ScrollRGBARight4(U32* pixels, int width, int height, U32 clear) {
+	for (int y = 0; y < height; y++) {
+		U32* row = pixels + y * width;
+#if defined(SCROLL_SIMD_ENABLED)
+		if (gScrollPath == SCROLL_AVX2) {
+			RGBARight4Avx2(row, width, clear);
+			continue;
+		}
+		if (gScrollPath == SCROLL_SSE2) {
+			RGBARight4Sse2(row, width, clear);
+			continue;
+		}
+#endif
+		RGBARight4Scalar(row, width, clear);
+	}
+}
+
+void ScrollRGBALeft4(U32* pixels, int width, int height, U32 clear) {
+	for (int y = 0; y < height; y++) {
+		U32* row = pixels + y * width;
+#if defined(SCROLL_SIMD_ENABLED)
+		if (gScrollPath == SCROLL_AVX2) {
+			RGBALeft4Avx2(row, width, clear);
+			continue;
+		}
+		if (gScrollPath == SCROLL_SSE2) {
+			RGBALeft4Sse2(row, width, clear);
+			continue;
+		}
+#endif
+		RGBALeft4Scalar(row, width, clear);
+	}
+}
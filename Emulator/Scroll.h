@@ -0,0 +1,29 @@
+#pragma once
+#include "OpCode.h"
+
+//Scroll kernels for 00CN, 00FB and 00FC, on the packed display plane and on RGBA pixels. Pixels scrolled in are cleared.
+//x86 builds use SSE2 and switch to AVX2 when the CPU supports it, other targets use the scalar loops.
+
+enum ScrollPath : U8 {
+	SCROLL_SCALAR,
+	SCROLL_SSE2,
+	SCROLL_AVX2
+};
+
+//True when the CPU and the OS support AVX2, also used by the other kernels that switch to it
+bool CpuHasAvx2();
+//Fastest path the CPU supports, used until SetScrollPath picks another one
+ScrollPath BestScrollPath();
+ScrollPath GetScrollPath();
+//For tests and benchmarks, a path the CPU does not support is replaced with BestScrollPath()
+void SetScrollPath(ScrollPath path);
+
+//The first words of each of height rows move, rows are stride words apart. The SIMD paths handle words of 1 and 2.
+void ScrollPlaneDown(U64* plane, int stride, int words, int height, int lines);
+void ScrollPlaneRight4(U64* plane, int stride, int words, int height);
+void ScrollPlaneLeft4(U64* plane, int stride, int words, int height);
+
+//width * height pixels row by row
+void ScrollRGBADown(U32* pixels, int width, int height, int lines, U32 clear);
+void ScrollRGBARight4(U32* pixels, int width, int height, U32 clear);
+void ScrollRGBALeft4(U32* pixels, int width, int height, U32 clear);
@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+
+#include "OpCode.h"
+
+//Lock-free ring for one producer thread and one consumer thread. Items stay in place: the producer fills the slot from
+//Reserve and publishes it with Commit, the consumer reads Front and releases it with Pop.
+template <class T, int SIZE>
+struct SpscQueue {
+	static_assert((SIZE & (SIZE - 1)) == 0, "SpscQueue size must be a power of two");
+
+	T m_Items[SIZE];
+	//Free running counters, the queue is full when they are SIZE apart. Kept on separate cache lines so that the two
+	//threads do not invalidate each other's counter.
+	alignas(64) std::atomic<U32> m_Head;
+	alignas(64) std::atomic<U32> m_Tail;
+
+	SpscQueue() : m_Head(0), m_Tail(0) {}
+
+	//Producer: the next free slot, or nullptr when the queue is full
+	T* Reserve() {
+		U32 tail = m_Tail.load(std::memory_order_relaxed);
+		if (tail - m_Head.load(std::memory_order_acquire) == SIZE)
+			return nullptr;
+		return &m_Items[tail & (SIZE - 1)];
+	}
+	void Commit() { m_Tail.store(m_Tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+	bool Push(const T& item) {
+		T* slot = Reserve();
+		if (slot == nullptr)
+			return false;
+		*slot = item;
+		Commit();
+		return true;
+	}
+
+	//Consumer: the oldest item, or nullptr when the queue is empty
+	T* Front() {
+		U32 head = m_Head.load(std::memory_order_relaxed);
+		if (head == m_Tail.load(std::memory_order_acquire))
+			return nullptr;
+		return &m_Items[head & (SIZE - 1)];
+	}
+	void Pop() { m_Head.store(m_Head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+	bool Pop(T& item) {
+		T* front = Front();
+		if (front == nullptr)
+			return false;
+		item = *front;
+		Pop();
+		return true;
+	}
+
+	//Producer: copies up to count items in, returns how many fitted
+	int Write(const T* items, int count) {
+		U32 tail = m_Tail.load(std::memory_order_relaxed);
+		U32 free = SIZE - (tail - m_Head.load(std::memory_order_acquire));
+		if ((U32)count > free)
+			count = (int)free;
+		for (int i = 0; i < count; i++)
+			m_Items[(tail + i) & (SIZE - 1)] = items[i];
+		m_Tail.store(tail + count, std::memory_order_release);
+		return count;
+	}
+	//Consumer: copies up to count of the oldest items out, returns how many there were
+	int Read(T* items, int count) {
+		U32 head = m_Head.load(std::memory_order_relaxed);
+		U32 used = m_Tail.load(std::memory_order_acquire) - head;
+		if ((U32)count > used)
+			count = (int)used;
+		for (int i = 0; i < count; i++)
+			items[i] = m_Items[(head + i) & (SIZE - 1)];
+		m_Head.store(head + count, std::memory_order_release);
+		return count;
+	}
+
+	//Either side, exact only from the consumer
+	U32 Size() const {
+		//Head first, the tail read after it can only be further ahead
+		U32 head = m_Head.load(std::memory_order_acquire);
+		return m_Tail.load(std::memory_order_acquire) - head;
+	}
+	bool Empty() const { return m_Head.load(std::memory_order_acquire) == m_Tail.load(std::memory_order_acquire); }
+};
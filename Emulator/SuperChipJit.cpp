@@ -0,0 +1,686 @@
+#include "SuperChipJit.h"
+#include <cstddef>
+
+#ifdef SUPERCHIP_JIT_ENABLED
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+using namespace std;
+
+#ifdef SUPERCHIP_JIT_ENABLED
+
+namespace {
+
+typedef void(*JitEnter)(JitContext* context, void* block);
+
+enum HostReg {
+	RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+	R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+//Host registers handed out to guest registers, RAX and RCX are scratch and RBX points to the JitContext
+const int gAllocatable[SuperChipJit::MAX_BLOCK_REGS] = { RDX, RSI, RDI, RBP, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+enum Condition {
+	CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_BE = 0x6, CC_A = 0x7, CC_L = 0xC
+};
+
+enum AluOp {
+	ALU_ADD = 0x01, ALU_OR = 0x09, ALU_AND = 0x21, ALU_SUB = 0x29, ALU_XOR = 0x31, ALU_CMP = 0x39
+};
+
+enum AluExt {
+	EXT_ADD = 0, EXT_OR = 1, EXT_AND = 4, EXT_SUB = 5, EXT_XOR = 6, EXT_CMP = 7
+};
+
+enum ShiftExt {
+	SHIFT_SHL = 4, SHIFT_SHR = 5
+};
+
+const U8 CTX_REG = offsetof(JitContext, reg);
+const U8 CTX_REGI = offsetof(JitContext, regI);
+const U8 CTX_PC = offsetof(JitContext, regPC);
+const U8 CTX_STACK = offsetof(JitContext, stack);
+const U8 CTX_SP = offsetof(JitContext, stackPointer);
+const U8 CTX_DELAY = offsetof(JitContext, timerDelay);
+const U8 CTX_KEY = offsetof(JitContext, key);
+const U8 CTX_CYCLES = offsetof(JitContext, cycles);
+
+//Pseudo register index of I next to V0-VF
+const int REG_I = 16;
+
+//Minimal x86-64 encoder for the handful of instructions the blocks need.
+//Memory operands are always [rbx + disp8] into the JitContext.
+struct Emitter {
+	U8* m_Code;
+	int m_Pos;
+
+	Emitter(U8* code) : m_Code(code), m_Pos(0) {}
+
+	U8* Here() { return m_Code + m_Pos; }
+	void Byte(U8 value) { m_Code[m_Pos++] = value; }
+	void Word(U16 value) { memcpy(m_Code + m_Pos, &value, 2); m_Pos += 2; }
+	void Dword(U32 value) { memcpy(m_Code + m_Pos, &value, 4); m_Pos += 4; }
+	void Qword(unsigned long long value) { memcpy(m_Code + m_Pos, &value, 8); m_Pos += 8; }
+
+	void Rex(bool wide, int reg, int rm, bool force = false) {
+		U8 rex = 0x40 | (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0);
+		if (rex != 0x40 || force)
+			Byte(rex);
+	}
+	void ModRM(int mod, int reg, int rm) { Byte((U8)((mod << 6) | ((reg & 7) << 3) | (rm & 7))); }
+	void Ctx(int reg, U8 disp) { ModRM(1, reg, RBX); Byte(disp); }
+
+	void MovImm(int dst, U32 value) { Rex(false, 0, dst); Byte(0xB8 + (dst & 7)); Dword(value); }
+	void MovImm64(int dst, const void* value) { Rex(true, 0, dst); Byte(0xB8 + (dst & 7)); Qword((unsigned long long)value); }
+	void Mov(int dst, int src) { Rex(false, src, dst); Byte(0x89); ModRM(3, src, dst); }
+	void Mov64(int dst, int src) { Rex(true, src, dst); Byte(0x89); ModRM(3, src, dst); }
+	void Alu(AluOp op, int dst, int src) { Rex(false, src, dst); Byte(op); ModRM(3, src, dst); }
+	void AluImm(AluExt ext, int dst, U32 value) { Rex(false, 0, dst); Byte(0x81); ModRM(3, ext, dst); Dword(value); }
+	void Shift1(ShiftExt ext, int reg) { Rex(false, 0, reg); Byte(0xD1); ModRM(3, ext, reg); }
+	void ShiftImm(ShiftExt ext, int reg, U8 count) { Rex(false, 0, reg); Byte(0xC1); ModRM(3, ext, reg); Byte(count); }
+	void ShrCl(int reg) { Rex(false, 0, reg); Byte(0xD3); ModRM(3, SHIFT_SHR, reg); }
+	void Imul(int dst, int src, U8 value) { Rex(false, dst, src); Byte(0x6B); ModRM(3, dst, src); Byte(value); }
+	//movzx r32, r8 - keeps a guest register within 8 bits
+	void Truncate8(int reg) { Rex(false, reg, reg, true); Byte(0x0F); Byte(0xB6); ModRM(3, reg, reg); }
+	void Setcc(Condition cc, int reg) { Rex(false, 0, reg, true); Byte(0x0F); Byte((U8)(0x90 + cc)); ModRM(3, 0, reg); }
+	void TestAl1() { Byte(0xA8); Byte(0x01); }
+	void TestRax() { Byte(0x48); Byte(0x85); Byte(0xC0); }
+
+	void LoadByte(int dst, U8 disp) { Rex(false, dst, RBX); Byte(0x0F); Byte(0xB6); Ctx(dst, disp); }
+	void LoadWord(int dst, U8 disp) { Rex(false, dst, RBX); Byte(0x0F); Byte(0xB7); Ctx(dst, disp); }
+	void StoreByte(U8 disp, int src) { Rex(false, src, RBX, true); Byte(0x88); Ctx(src, disp); }
+	void StoreWord(U8 disp, int src) { Byte(0x66); Rex(false, src, RBX); Byte(0x89); Ctx(src, disp); }
+	void StoreWordImm(U8 disp, U16 value) { Byte(0x66); Byte(0xC7); Ctx(0, disp); Word(value); }
+	void CmpMemImm(U8 disp, U32 value) { Byte(0x81); Ctx(EXT_CMP, disp); Dword(value); }
+	void SubMemImm(U8 disp, U32 value) { Byte(0x81); Ctx(EXT_SUB, disp); Dword(value); }
+	void IncMemByte(U8 disp) { Byte(0xFE); Ctx(0, disp); }
+	void DecMemByte(U8 disp) { Byte(0xFE); Ctx(1, disp); }
+	//mov word [rbx + rax * 2 + disp], value
+	void StoreStackImm(U8 disp, U16 value) { Byte(0x66); Byte(0xC7); Byte(0x44); Byte(0x43); Byte(disp); Word(value); }
+	//movzx eax, word [rbx + rax * 2 + disp]
+	void LoadStack(U8 disp) { Byte(0x0F); Byte(0xB7); Byte(0x44); Byte(0x43); Byte(disp); }
+	//mov rax, [rax]
+	void LoadRaxIndirect() { Byte(0x48); Byte(0x8B); Byte(0x00); }
+	//mov rax, [rcx + rax * 8]
+	void LoadRaxIndexed() { Byte(0x48); Byte(0x8B); Byte(0x04); Byte(0xC1); }
+
+	void Push(int reg) { Rex(false, 0, reg); Byte(0x50 + (reg & 7)); }
+	void Pop(int reg) { Rex(false, 0, reg); Byte(0x58 + (reg & 7)); }
+	void Ret() { Byte(0xC3); }
+	void JmpReg(int reg) { Rex(false, 0, reg); Byte(0xFF); ModRM(3, 4, reg); }
+	void Jmp(const U8* target) { Byte(0xE9); Dword((U32)(target - (Here() + 4))); }
+	void Jcc(Condition cc, const U8* target) { Byte(0x0F); Byte((U8)(0x80 + cc)); Dword((U32)(target - (Here() + 4))); }
+	//Forward conditional jump, returns the position to patch
+	int JccForward(Condition cc) { Byte(0x0F); Byte((U8)(0x80 + cc)); Dword(0); return m_Pos - 4; }
+	void Patch(int at) { U32 rel = (U32)(m_Pos - (at + 4)); memcpy(m_Code + at, &rel, 4); }
+};
+
+bool IsCompiled(U8 handler) {
+	switch (handler) {
+		case OP_6XNN: case OP_7XNN:
+		case OP_8XY0: case OP_8XY1: case OP_8XY2: case OP_8XY3: case OP_8XY4:
+		case OP_8XY5: case OP_8XY6: case OP_8XY7: case OP_8XYE:
+		case OP_ANNN: case OP_FX07: case OP_FX15:
+		case OP_FX1E: case OP_FX29: case OP_FX30:
+		case OP_1NNN: case OP_2NNN: case OP_00EE: case OP_BNNN:
+		case OP_3XNN: case OP_4XNN: case OP_5XY0: case OP_9XY0:
+		case OP_EX9E: case OP_EXA1:
+			return true;
+		default:
+			return false;
+	}
+}
+
+bool IsTerminator(U8 handler) {
+	switch (handler) {
+		case OP_1NNN: case OP_2NNN: case OP_00EE: case OP_BNNN:
+		case OP_3XNN: case OP_4XNN: case OP_5XY0: case OP_9XY0:
+		case OP_EX9E: case OP_EXA1:
+			return true;
+		default:
+			return false;
+	}
+}
+
+//Pseudo registers an opcode reads or writes, returns how many
+int UsedRegs(const DecodedOp& op, int regs[3]) {
+	switch (op.handler) {
+		case OP_6XNN: case OP_7XNN: case OP_3XNN: case OP_4XNN:
+		case OP_FX07: case OP_FX15: case OP_EX9E: case OP_EXA1:
+			regs[0] = op.x;
+			return 1;
+		case OP_8XY0: case OP_8XY1: case OP_8XY2: case OP_8XY3: case OP_5XY0: case OP_9XY0:
+			regs[0] = op.x; regs[1] = op.y;
+			return 2;
+		case OP_8XY4: case OP_8XY5: case OP_8XY7:
+			regs[0] = op.x; regs[1] = op.y; regs[2] = 0xF;
+			return 3;
+		case OP_8XY6: case OP_8XYE:
+			regs[0] = op.x; regs[1] = 0xF; regs[2] = op.y;
+			return SuperChipPolicy::SHIFT_VY ? 3 : 2;
+		case OP_ANNN:
+			regs[0] = REG_I;
+			return 1;
+		case OP_FX1E:
+			regs[0] = op.x; regs[1] = REG_I; regs[2] = 0xF;
+			return 3;
+		case OP_FX29: case OP_FX30:
+			regs[0] = op.x; regs[1] = REG_I;
+			return 2;
+		case OP_BNNN:
+			regs[0] = SuperChipPolicy::JUMP_VX ? op.x : 0;
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+}
+
+#endif
+
+SuperChipJit::SuperChipJit(SuperChip& chip) : m_Chip(chip), m_CompileThreshold(DEFAULT_COMPILE_THRESHOLD), m_Code(nullptr), m_CodeUsed(0), m_EnterStub(nullptr), m_ExitStub(nullptr) {
+	memset(m_EntryCount, 0, sizeof(m_EntryCount));
+
+#ifdef SUPERCHIP_JIT_ENABLED
+#ifdef _WIN32
+	m_Code = (U8*)VirtualAlloc(NULL, CODE_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+#else
+	void* code = mmap(NULL, CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	m_Code = code == MAP_FAILED ? nullptr : (U8*)code;
+#endif
+	if (m_Code == nullptr) {
+		cout << "Unable to allocate executable memory, using the interpreter." << endl;
+	}
+#endif
+
+	Flush();
+	ResetStats();
+	m_Chip.SetCodeWriteCallback([this](U16 address, U16 length) { Invalidate(address, length); });
+}
+
+SuperChipJit::~SuperChipJit() {
+	m_Chip.SetCodeWriteCallback(nullptr);
+
+#ifdef SUPERCHIP_JIT_ENABLED
+	if (m_Code != nullptr) {
+#ifdef _WIN32
+		VirtualFree(m_Code, 0, MEM_RELEASE);
+#else
+		munmap(m_Code, CODE_SIZE);
+#endif
+	}
+#endif
+}
+
+void SuperChipJit::Flush() {
+	memset(m_Blocks, 0, sizeof(m_Blocks));
+	memset(m_SlotState, SLOT_UNKNOWN, sizeof(m_SlotState));
+	memset(m_BlockBytes, 0, sizeof(m_BlockBytes));
+	m_CodeUsed = 0;
+	m_Stats.flushes++;
+	EmitStubs();
+}
+
+void SuperChipJit::Invalidate(U16 address, U16 length) {
+	if (length == 0)
+		return;
+
+	//A new rom, start profiling from scratch
+	if (length >= sizeof(m_Chip.m_Memory)) {
+		memset(m_EntryCount, 0, sizeof(m_EntryCount));
+		Flush();
+		return;
+	}
+
+	int first = address;
+	int last = address + length - 1;
+	if (last >= DECODED_SLOTS)
+		last = DECODED_SLOTS - 1;
+
+	//Any block starting up to 2 * MAX_BLOCK_OPS bytes before a written byte may cover it
+	for (int written = first; written <= last; written++) {
+		int start = written - 2 * MAX_BLOCK_OPS + 1;
+		if (start < 0)
+			start = 0;
+		for (int block = start; block <= written; block++) {
+			if (m_SlotState[block] != SLOT_UNKNOWN && block + m_BlockBytes[block] > written) {
+				m_SlotState[block] = SLOT_UNKNOWN;
+				m_Blocks[block] = nullptr;
+				//Rewritten code has to get hot again before it is compiled again
+				m_EntryCount[block] = 0;
+				m_Stats.blocksInvalidated++;
+				if (m_TierCallback)
+					m_TierCallback((U16)block, SLOT_UNKNOWN);
+			}
+		}
+	}
+}
+
+U32 SuperChipJit::Run(int cycles) {
+	return RunUntil(EVENT_EXIT, cycles);
+}
+
+U32 SuperChipJit::RunUntil(U32 stopEvents, int maxCycles, int* executed) {
+	U32 events = 0;
+	int cycles = maxCycles;
+
+	while (cycles > 0 && (events & stopEvents) == 0) {
+#ifdef SUPERCHIP_JIT_ENABLED
+		void* block = nullptr;
+		U16 pc = m_Chip.m_RegPC;
+		if (m_Code != nullptr && pc < sizeof(m_Chip.m_Memory)) {
+			//Cold code stays on the interpreter until it was entered often enough
+			if (m_SlotState[pc] == SLOT_UNKNOWN && ++m_EntryCount[pc] >= m_CompileThreshold) {
+				Compile(pc);
+				if (m_SlotState[pc] == SLOT_COMPILED)
+					m_Stats.blocksCompiled++;
+				else
+					m_Stats.blocksInterpreted++;
+				if (m_TierCallback)
+					m_TierCallback(pc, (SlotState)m_SlotState[pc]);
+			}
+			block = m_Blocks[pc];
+		}
+
+		if (block != nullptr) {
+			memcpy(m_Context.reg, m_Chip.m_Reg, sizeof(m_Context.reg));
+			m_Context.regI = m_Chip.m_RegI;
+			m_Context.regPC = m_Chip.m_RegPC;
+			memcpy(m_Context.stack, m_Chip.m_Stack, sizeof(m_Context.stack));
+			m_Context.stackPointer = m_Chip.m_StackPointer;
+			m_Context.timerDelay = m_Chip.m_TimerDelay;
+			m_Context.key = m_Chip.m_Key;
+			m_Context.cycles = cycles;
+			m_Stats.nativeEntries++;
+
+			((JitEnter)m_EnterStub)(&m_Context, block);
+
+			memcpy(m_Chip.m_Reg, m_Context.reg, sizeof(m_Context.reg));
+			m_Chip.m_RegI = m_Context.regI;
+			m_Chip.m_RegPC = m_Context.regPC;
+			memcpy(m_Chip.m_Stack, m_Context.stack, sizeof(m_Context.stack));
+			m_Chip.m_StackPointer = m_Context.stackPointer;
+			m_Chip.m_TimerDelay = m_Context.timerDelay;
+
+			//A block that did not fit in the remaining budget exits without executing anything
+			if (m_Context.cycles != cycles) {
+				cycles = m_Context.cycles;
+				continue;
+			}
+		}
+#endif
+
+		U32 stepEvents = m_Chip.RunCycles(1);
+		events |= stepEvents;
+		cycles--;
+		m_Stats.interpretedSteps++;
+
+		//The rom is waiting, let the interpreter skip the rest of the budget
+		if ((stepEvents & EVENT_IDLE) != 0 && cycles > 0 && (events & stopEvents) == 0) {
+			int skipped = 0;
+			events |= m_Chip.RunUntil(stopEvents, cycles, &skipped);
+			m_Stats.interpretedSteps += skipped;
+			cycles -= skipped;
+		}
+	}
+
+	if (executed != nullptr)
+		*executed = maxCycles - cycles;
+	m_Chip.m_DoRedraw = (events & EVENT_REDRAW) != 0;
+	return events;
+}
+
+void SuperChipJit::EmitStubs() {
+#ifdef SUPERCHIP_JIT_ENABLED
+	if (m_Code == nullptr)
+		return;
+
+	static const int saved[] = { RBX, RBP, RSI, RDI, R12, R13, R14, R15 };
+	Emitter e(m_Code);
+
+	//void Enter(JitContext* context, void* block)
+	m_EnterStub = e.Here();
+	for (int i = 0; i < 8; i++) {
+		e.Push(saved[i]);
+	}
+#ifdef _WIN32
+	e.Mov64(RBX, RCX);
+	e.JmpReg(RDX);
+#else
+	e.Mov64(RBX, RDI);
+	e.JmpReg(RSI);
+#endif
+
+	//Every block leaves through here with the guest state written back to the context
+	m_ExitStub = e.Here();
+	for (int i = 7; i >= 0; i--) {
+		e.Pop(saved[i]);
+	}
+	e.Ret();
+
+	m_CodeUsed = e.m_Pos;
+#endif
+}
+
+void* SuperChipJit::Compile(U16 address) {
+#ifdef SUPERCHIP_JIT_ENABLED
+
+	//Find the extent of the block and assign host registers
+	DecodedOp ops[MAX_BLOCK_OPS];
+	int hostReg[17];
+	bool dirty[17];
+	int usedRegs[MAX_BLOCK_REGS];
+	int regCount = 0;
+	int count = 0;
+	U16 pc = address;
+
+	for (int i = 0; i < 17; i++) {
+		hostReg[i] = -1;
+		dirty[i] = false;
+	}
+
+	while (count < MAX_BLOCK_OPS && pc + 1 < (int)sizeof(m_Chip.m_Memory)) {
+		DecodedOp op = DecodeOpCode((m_Chip.m_Memory[pc] << 8) | m_Chip.m_Memory[pc + 1], true);
+		//Delay timer spins are left to the interpreter, which skips them
+		if (!IsCompiled(op.handler) || IsDelaySpin(m_Chip.m_Memory, pc))
+			break;
+
+		int regs[3] = {};
+		int regsUsed = UsedRegs(op, regs);
+		int newRegs = 0;
+		for (int i = 0; i < regsUsed; i++) {
+			bool seen = hostReg[regs[i]] >= 0;
+			for (int j = 0; j < i; j++) {
+				seen |= regs[j] == regs[i];
+			}
+			if (!seen)
+				newRegs++;
+		}
+		if (regCount + newRegs > MAX_BLOCK_REGS)
+			break;
+		for (int i = 0; i < regsUsed; i++) {
+			if (hostReg[regs[i]] < 0) {
+				hostReg[regs[i]] = gAllocatable[regCount];
+				usedRegs[regCount++] = regs[i];
+			}
+		}
+
+		ops[count++] = op;
+		pc += 2;
+		if (IsTerminator(op.handler))
+			break;
+	}
+
+	if (count == 0) {
+		m_SlotState[address] = SLOT_INTERPRETED;
+		m_BlockBytes[address] = 2;
+		return nullptr;
+	}
+
+	//Worst case is well below 64 bytes per opcode
+	if (m_CodeUsed + (count + 4) * 64 > CODE_SIZE) {
+		Flush();
+	}
+
+	Emitter e(m_Code + m_CodeUsed);
+	U8* entry = e.Here();
+
+	//Leave without executing anything when the block does not fit in the budget
+	e.CmpMemImm(CTX_CYCLES, count);
+	e.Jcc(CC_L, m_ExitStub);
+	e.SubMemImm(CTX_CYCLES, count);
+
+	for (int i = 0; i < regCount; i++) {
+		if (usedRegs[i] == REG_I)
+			e.LoadWord(hostReg[REG_I], CTX_REGI);
+		else
+			e.LoadByte(hostReg[usedRegs[i]], (U8)(CTX_REG + usedRegs[i]));
+	}
+
+	auto writeBack = [&]() {
+		for (int i = 0; i < regCount; i++) {
+			int reg = usedRegs[i];
+			if (!dirty[reg])
+				continue;
+			if (reg == REG_I)
+				e.StoreWord(CTX_REGI, hostReg[REG_I]);
+			else
+				e.StoreByte((U8)(CTX_REG + reg), hostReg[reg]);
+		}
+	};
+
+	//Continue at a fixed address, through the block table when a block exists there
+	auto chain = [&](U16 target) {
+		e.StoreWordImm(CTX_PC, target);
+		if (target >= sizeof(m_Chip.m_Memory)) {
+			e.Jmp(m_ExitStub);
+			return;
+		}
+		e.MovImm64(RAX, &m_Blocks[target]);
+		e.LoadRaxIndirect();
+		e.TestRax();
+		e.Jcc(CC_E, m_ExitStub);
+		e.JmpReg(RAX);
+	};
+
+	//Continue at the address in eax
+	auto dispatch = [&]() {
+		e.StoreWord(CTX_PC, RAX);
+		e.AluImm(EXT_CMP, RAX, sizeof(m_Chip.m_Memory));
+		e.Jcc(CC_AE, m_ExitStub);
+		e.MovImm64(RCX, m_Blocks);
+		e.LoadRaxIndexed();
+		e.TestRax();
+		e.Jcc(CC_E, m_ExitStub);
+		e.JmpReg(RAX);
+	};
+
+	//Skip family: flags are set by the caller, writeBack only moves and keeps them intact
+	auto skip = [&](Condition taken, U16 next) {
+		writeBack();
+		int patch = e.JccForward(taken);
+		chain(next);
+		e.Patch(patch);
+		chain(next + 2);
+	};
+
+	pc = address;
+	bool terminated = false;
+	for (int i = 0; i < count; i++) {
+		const DecodedOp& op = ops[i];
+		int vx = hostReg[op.x];
+		int vy = hostReg[op.y];
+		int vf = hostReg[0xF];
+		int regI = hostReg[REG_I];
+		pc += 2;
+
+		switch (op.handler) {
+			case OP_6XNN:
+				e.MovImm(vx, op.nn);
+				dirty[op.x] = true;
+				break;
+			case OP_7XNN:
+				e.AluImm(EXT_ADD, vx, op.nn);
+				e.Truncate8(vx);
+				dirty[op.x] = true;
+				break;
+			case OP_8XY0:
+				e.Mov(vx, vy);
+				dirty[op.x] = true;
+				break;
+			case OP_8XY1:
+				e.Alu(ALU_OR, vx, vy);
+				dirty[op.x] = true;
+				break;
+			case OP_8XY2:
+				e.Alu(ALU_AND, vx, vy);
+				dirty[op.x] = true;
+				break;
+			case OP_8XY3:
+				e.Alu(ALU_XOR, vx, vy);
+				dirty[op.x] = true;
+				break;
+			case OP_8XY4:
+				//Same statement order as the interpreter so that X or Y being F behaves identically
+				e.Alu(ALU_ADD, vx, vy);
+				e.Truncate8(vx);
+				e.MovImm(vf, 0);
+				e.MovImm(RAX, 0xFF);
+				e.Alu(ALU_SUB, RAX, vx);
+				e.Alu(ALU_CMP, vy, RAX);
+				e.Setcc(CC_A, vf);
+				dirty[op.x] = dirty[0xF] = true;
+				break;
+			case OP_8XY5:
+				e.Alu(ALU_SUB, vx, vy);
+				e.Truncate8(vx);
+				e.MovImm(vf, 1);
+				e.MovImm(RAX, 0xFF);
+				e.Alu(ALU_SUB, RAX, vx);
+				e.Alu(ALU_CMP, vy, RAX);
+				e.Setcc(CC_BE, vf);
+				dirty[op.x] = dirty[0xF] = true;
+				break;
+			case OP_8XY6:
+				if (SuperChipPolicy::SHIFT_VY)
+					e.Mov(vx, vy);
+				e.Mov(RAX, vx);
+				e.AluImm(EXT_AND, RAX, 1);
+				e.Mov(vf, RAX);
+				e.Shift1(SHIFT_SHR, vx);
+				dirty[op.x] = dirty[0xF] = true;
+				break;
+			case OP_8XY7:
+				e.Mov(RAX, vy);
+				e.Alu(ALU_SUB, RAX, vx);
+				e.Mov(vx, RAX);
+				e.Truncate8(vx);
+				e.MovImm(vf, 1);
+				e.Alu(ALU_CMP, vy, vx);
+				e.Setcc(CC_AE, vf);
+				dirty[op.x] = dirty[0xF] = true;
+				break;
+			case OP_8XYE:
+				if (SuperChipPolicy::SHIFT_VY)
+					e.Mov(vx, vy);
+				e.Mov(RAX, vx);
+				e.ShiftImm(SHIFT_SHR, RAX, 7);
+				e.Mov(vf, RAX);
+				e.Shift1(SHIFT_SHL, vx);
+				e.Truncate8(vx);
+				dirty[op.x] = dirty[0xF] = true;
+				break;
+			case OP_ANNN:
+				e.MovImm(regI, op.nnn);
+				dirty[REG_I] = true;
+				break;
+			case OP_FX07:
+				e.LoadByte(vx, CTX_DELAY);
+				dirty[op.x] = true;
+				break;
+			case OP_FX15:
+				e.StoreByte(CTX_DELAY, vx);
+				break;
+			case OP_FX1E:
+				e.Alu(ALU_ADD, regI, vx);
+				e.AluImm(EXT_AND, regI, 0xFFFF);
+				e.AluImm(EXT_CMP, regI, 0xFFF);
+				e.MovImm(vf, 0);
+				e.Setcc(CC_A, vf);
+				dirty[REG_I] = dirty[0xF] = true;
+				break;
+			case OP_FX29:
+				e.Imul(regI, vx, 5);
+				dirty[REG_I] = true;
+				break;
+			case OP_FX30:
+				e.Imul(regI, vx, 10);
+				e.AluImm(EXT_ADD, regI, SuperChip::SUPERFONT_START);
+				dirty[REG_I] = true;
+				break;
+			case OP_1NNN:
+				writeBack();
+				chain(op.nnn);
+				terminated = true;
+				break;
+			case OP_2NNN:
+				writeBack();
+				e.LoadByte(RAX, CTX_SP);
+				e.AluImm(EXT_AND, RAX, 0xF);
+				e.StoreStackImm(CTX_STACK, pc);
+				e.IncMemByte(CTX_SP);
+				chain(op.nnn);
+				terminated = true;
+				break;
+			case OP_00EE:
+				writeBack();
+				e.DecMemByte(CTX_SP);
+				e.LoadByte(RAX, CTX_SP);
+				e.AluImm(EXT_AND, RAX, 0xF);
+				e.LoadStack(CTX_STACK);
+				dispatch();
+				terminated = true;
+				break;
+			case OP_BNNN:
+				writeBack();
+				e.Mov(RAX, hostReg[SuperChipPolicy::JUMP_VX ? op.x : 0]);
+				e.AluImm(EXT_ADD, RAX, op.nnn);
+				e.AluImm(EXT_AND, RAX, 0xFFFF);
+				dispatch();
+				terminated = true;
+				break;
+			case OP_3XNN:
+				e.AluImm(EXT_CMP, vx, op.nn);
+				skip(CC_E, pc);
+				terminated = true;
+				break;
+			case OP_4XNN:
+				e.AluImm(EXT_CMP, vx, op.nn);
+				skip(CC_NE, pc);
+				terminated = true;
+				break;
+			case OP_5XY0:
+				e.Alu(ALU_CMP, vx, vy);
+				skip(CC_E, pc);
+				terminated = true;
+				break;
+			case OP_9XY0:
+				e.Alu(ALU_CMP, vx, vy);
+				skip(CC_NE, pc);
+				terminated = true;
+				break;
+			case OP_EX9E:
+			case OP_EXA1:
+				e.Mov(RCX, vx);
+				e.LoadWord(RAX, CTX_KEY);
+				e.ShrCl(RAX);
+				e.TestAl1();
+				skip(op.handler == OP_EX9E ? CC_NE : CC_E, pc);
+				terminated = true;
+				break;
+			default:
+				break;
+		}
+	}
+
+	if (!terminated) {
+		writeBack();
+		chain(pc);
+	}
+
+	m_CodeUsed += e.m_Pos;
+	m_Blocks[address] = entry;
+	m_SlotState[address] = SLOT_COMPILED;
+	m_BlockBytes[address] = (U8)(count * 2);
+	return entry;
+#else
+	(void)address;
+	return nullptr;
+#endif
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstring>
+#include <functional>
+
+#include "SuperChip.h"
+
+//The recompiler emits x86-64 machine code, other targets only use the interpreter.
+#if defined(_M_X64) || defined(__x86_64__)
+#define SUPERCHIP_JIT_ENABLED
+#endif
+
+//Guest state as seen by compiled blocks. Copied from and back to the SuperChip around native execution.
+struct JitContext {
+	U8 reg[16];
+	U16 regI;
+	U16 regPC;
+	U16 stack[16];
+	U8 stackPointer;
+	U8 timerDelay;
+	U16 padding;
+	U16 key;
+	U16 padding2;
+	int cycles;
+};
+
+//Translates straight-line runs of SuperChip opcodes into native code.
+//A block ends at a branch, at an opcode that is left to the interpreter (DXYN, FX0A, FX18, ...) or after MAX_BLOCK_OPS opcodes.
+//Blocks chain to each other through the block table, SuperChip::RunCycles executes everything that is not compiled.
+//Code starts out on the interpreter, an address is only compiled after execution reached it m_CompileThreshold times.
+struct SuperChipJit {
+	static const int MAX_BLOCK_OPS = 64;
+	static const int MAX_BLOCK_REGS = 12;
+	static const int CODE_SIZE = 1024 * 1024;
+	static const int DEFAULT_COMPILE_THRESHOLD = 16;
+
+	enum SlotState : U8 {
+		SLOT_UNKNOWN = 0,
+		SLOT_COMPILED,
+		SLOT_INTERPRETED
+	};
+
+	//Counters for tuning the compile threshold, cleared by ResetStats
+	struct Stats {
+		U32 interpretedSteps;	//Instructions run by the interpreter
+		U32 nativeEntries;		//Calls from Run into compiled code
+		U32 blocksCompiled;
+		U32 blocksInterpreted;	//Hot addresses that could not start a block
+		U32 blocksInvalidated;	//Blocks dropped because their code was written
+		U32 flushes;
+	};
+
+	SuperChip& m_Chip;
+	JitContext m_Context;
+
+	//Native entry point for every address, null when no block starts there
+	void* m_Blocks[DECODED_SLOTS];
+	U8 m_SlotState[DECODED_SLOTS];
+	//Number of bytes covered by the block starting at an address
+	U8 m_BlockBytes[DECODED_SLOTS];
+	//Times execution reached an address without a block, cleared when a new rom is loaded or the block there was
+	//invalidated by a write. A flush for lack of code space keeps it, hot code compiles again on its next entry.
+	U16 m_EntryCount[DECODED_SLOTS];
+	int m_CompileThreshold;
+	Stats m_Stats;
+	std::function<void(U16, SlotState)> m_TierCallback;
+
+	U8* m_Code;
+	int m_CodeUsed;
+	U8* m_EnterStub;
+	U8* m_ExitStub;
+
+	SuperChipJit(SuperChip& chip);
+	~SuperChipJit();
+
+	//Executes cycles instructions, natively where possible, and returns the RunEvent flags like SuperChip::RunCycles
+	U32 Run(int cycles);
+	//Runs until an instruction raises one of stopEvents or maxCycles instructions have run, like SuperChip::RunUntil.
+	//FX18 always runs on the interpreter, so the sound events stop the run right after it.
+	U32 RunUntil(U32 stopEvents, int maxCycles, int* executed = nullptr);
+	//Drops all compiled blocks
+	void Flush();
+	//Drops the blocks that contain any byte in [address, address + length)
+	void Invalidate(U16 address, U16 length);
+
+	//Entries before an address is compiled, 0 and 1 compile on first entry
+	void SetCompileThreshold(int threshold) { m_CompileThreshold = threshold < 0 ? 0 : threshold > 0xFFFF ? 0xFFFF : threshold; }
+	void ResetStats() { memset(&m_Stats, 0, sizeof(m_Stats)); }
+	//Called with the address and its new state when an address is compiled, left to the interpreter or invalidated
+	void SetTierCallback(std::function<void(U16, SlotState)> callback) { m_TierCallback = callback; }
+
+private:
+	SuperChipJit(const SuperChipJit&);
+	SuperChipJit& operator=(const SuperChipJit&);
+
+	void* Compile(U16 address);
+	void EmitStubs();
+};
@@ -0,0 +1,40 @@
+#pragma once
+#include <atomic>
+
+#include "OpCode.h"
+
+//Lock-free handoff of the newest item from one producer thread to one consumer thread. Each side owns one of three
+//slots and the third is swapped between them, so neither ever waits for the other. The producer overwrites items the
+//consumer did not take in time, the consumer sees the same item until a newer one is published.
+template <class T>
+struct TripleBuffer {
+	static const U8 INDEX_MASK = 0x03;
+	//Set in m_Middle when it holds an item the consumer has not taken yet
+	static const U8 FRESH = 0x04;
+
+	T m_Slots[3];
+	alignas(64) std::atomic<U8> m_Middle;
+	//Owned by the producer and the consumer
+	alignas(64) U8 m_Back;
+	alignas(64) U8 m_Front;
+
+	TripleBuffer() : m_Middle(1), m_Back(0), m_Front(2) {}
+
+	//Producer: the slot to fill next. It holds the item published two times ago, or one the consumer dropped.
+	T& Back() { return m_Slots[m_Back]; }
+	//Producer: makes Back() the newest item. Returns false when the previously published item was never taken.
+	bool Publish() {
+		U8 previous = m_Middle.exchange(m_Back | FRESH, std::memory_order_acq_rel);
+		m_Back = previous & INDEX_MASK;
+		return (previous & FRESH) == 0;
+	}
+
+	//Consumer: moves Front() to the newest item, false when nothing was published since the last call
+	bool Update() {
+		if ((m_Middle.load(std::memory_order_relaxed) & FRESH) == 0)
+			return false;
+		m_Front = m_Middle.exchange(m_Front, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+	const T& Front() const { return m_Slots[m_Front]; }
+};
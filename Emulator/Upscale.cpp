@@ -0,0 +1,166 @@
+#include "Upscale.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define UPSCALE_SSE2_ENABLED
+#include <emmintrin.h>
+#endif
+
+//Bit k of a byte moved to bit 3 * k
+static U32 sSpread3[256];
+
+static bool InitSpread3() {
+	for (int value = 0; value < 256; value++) {
+		U32 spread = 0;
+		for (int k = 0; k < 8; k++) {
+			if ((value >> k) & 1)
+				spread |= 1 << (3 * k);
+		}
+		sSpread3[value] = spread;
+	}
+	return true;
+}
+static bool sSpread3Ready = InitSpread3();
+
+//Bit k of 32 moved to bit 2 * k
+static inline U64 Spread2(U64 value) {
+	value = (value | (value << 16)) & 0x0000FFFF0000FFFFull;
+	value = (value | (value << 8)) & 0x00FF00FF00FF00FFull;
+	value = (value | (value << 4)) & 0x0F0F0F0F0F0F0F0Full;
+	value = (value | (value << 2)) & 0x3333333333333333ull;
+	value = (value | (value << 1)) & 0x5555555555555555ull;
+	return value;
+}
+
+//Two words of output, pixel 2x from first and 2x + 1 from second
+static inline void Interleave2(U64 first, U64 second, U64* out) {
+	out[0] = (Spread2(first >> 32) << 1) | Spread2(second >> 32);
+	out[1] = (Spread2(first & 0xFFFFFFFF) << 1) | Spread2(second & 0xFFFFFFFF);
+}
+
+//Three words of output, pixel 3x from first, 3x + 1 from second and 3x + 2 from third
+static inline void Interleave3(U64 first, U64 second, U64 third, U64* out) {
+	U64 bits[8];
+	for (int i = 0; i < 8; i++) {
+		int shift = 56 - i * 8;
+		bits[i] = (sSpread3[(first >> shift) & 0xFF] << 2) | (sSpread3[(second >> shift) & 0xFF] << 1) | sSpread3[(third >> shift) & 0xFF];
+	}
+	//24 bits per source byte, packed from the top bit of the first word
+	out[0] = (bits[0] << 40) | (bits[1] << 16) | (bits[2] >> 8);
+	out[1] = (bits[2] << 56) | (bits[3] << 32) | (bits[4] << 8) | (bits[5] >> 16);
+	out[2] = (bits[5] << 48) | (bits[6] << 24) | bits[7];
+}
+
+//Each pixel's left and right neighbor, the edge pixels are their own neighbors
+static inline U64 Left(const U64* row, int w) {
+	U64 carry = w > 0 ? row[w - 1] << 63 : row[w] & ((U64)1 << 63);
+	return (row[w] >> 1) | carry;
+}
+
+static inline U64 Right(const U64* row, int w, int words) {
+	U64 carry = w + 1 < words ? row[w + 1] >> 63 : row[w] & 1;
+	return (row[w] << 1) | carry;
+}
+
+//Bits set where a and b are equal
+static inline U64 Equal(U64 a, U64 b) {
+	return ~(a ^ b);
+}
+
+static inline U64 Select(U64 mask, U64 a, U64 b) {
+	return (mask & a) | (~mask & b);
+}
+
+void Scale2xPlane(const U64* plane, int stride, int words, int height, U64* out) {
+	for (int y = 0; y < height; y++) {
+		const U64* above = plane + (y > 0 ? y - 1 : 0) * stride;
+		const U64* row = plane + y * stride;
+		const U64* below = plane + (y + 1 < height ? y + 1 : y) * stride;
+		U64* top = out + y * 2 * words * 2;
+		U64* bottom = top + words * 2;
+		for (int w = 0; w < words; w++) {
+			//Neighbors named as in the Scale2x description: B above, D left, F right, H below
+			U64 b = above[w];
+			U64 d = Left(row, w);
+			U64 e = row[w];
+			U64 f = Right(row, w, words);
+			U64 h = below[w];
+			U64 db = Equal(d, b);
+			U64 bf = Equal(b, f);
+			U64 dh = Equal(d, h);
+			U64 hf = Equal(h, f);
+			Interleave2(Select(db & ~bf & ~dh, d, e), Select(bf & ~db & ~hf, f, e), top + w * 2);
+			Interleave2(Select(dh & ~db & ~hf, d, e), Select(hf & ~dh & ~bf, f, e), bottom + w * 2);
+		}
+	}
+}
+
+void Scale3xPlane(const U64* plane, int stride, int words, int height, U64* out) {
+	for (int y = 0; y < height; y++) {
+		const U64* above = plane + (y > 0 ? y - 1 : 0) * stride;
+		const U64* row = plane + y * stride;
+		const U64* below = plane + (y + 1 < height ? y + 1 : y) * stride;
+		U64* top = out + y * 3 * words * 3;
+		U64* middle = top + words * 3;
+		U64* bottom = middle + words * 3;
+		for (int w = 0; w < words; w++) {
+			//A B C above, D E F on the row, G H I below
+			U64 a = Left(above, w);
+			U64 b = above[w];
+			U64 c = Right(above, w, words);
+			U64 d = Left(row, w);
+			U64 e = row[w];
+			U64 f = Right(row, w, words);
+			U64 g = Left(below, w);
+			U64 h = below[w];
+			U64 i = Right(below, w, words);
+			U64 db = Equal(d, b);
+			U64 bf = Equal(b, f);
+			U64 dh = Equal(d, h);
+			U64 hf = Equal(h, f);
+			//The four corner rules of Scale2x
+			U64 topLeft = db & ~bf & ~dh;
+			U64 topRight = bf & ~db & ~hf;
+			U64 bottomLeft = dh & ~db & ~hf;
+			U64 bottomRight = hf & ~dh & ~bf;
+			Interleave3(Select(topLeft, d, e),
+				Select((topLeft & ~Equal(e, c)) | (topRight & ~Equal(e, a)), b, e),
+				Select(topRight, f, e), top + w * 3);
+			Interleave3(Select((topLeft & ~Equal(e, g)) | (bottomLeft & ~Equal(e, a)), d, e),
+				e,
+				Select((topRight & ~Equal(e, i)) | (bottomRight & ~Equal(e, c)), f, e), middle + w * 3);
+			Interleave3(Select(bottomLeft, d, e),
+				Select((bottomLeft & ~Equal(e, i)) | (bottomRight & ~Equal(e, g)), h, e),
+				Select(bottomRight, f, e), bottom + w * 3);
+		}
+	}
+}
+
+void PlaneToRGBA(const U64* plane, int stride, int words, int height, U32 onColor, U32 offColor, U32* out) {
+#if defined(UPSCALE_SSE2_ENABLED)
+	//Eight pixels per byte, each lane tests its own bit and picks a color
+	const __m128i on = _mm_set1_epi32((int)onColor);
+	const __m128i off = _mm_set1_epi32((int)offColor);
+	const __m128i firstBits = _mm_set_epi32(0x10, 0x20, 0x40, 0x80);
+	const __m128i secondBits = _mm_set_epi32(0x01, 0x02, 0x04, 0x08);
+	for (int y = 0; y < height; y++) {
+		const U64* row = plane + y * stride;
+		for (int w = 0; w < words; w++) {
+			for (int shift = 56; shift >= 0; shift -= 8) {
+				__m128i bits = _mm_set1_epi32((int)((row[w] >> shift) & 0xFF));
+				__m128i first = _mm_cmpeq_epi32(_mm_and_si128(bits, firstBits), firstBits);
+				__m128i second = _mm_cmpeq_epi32(_mm_and_si128(bits, secondBits), secondBits);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_or_si128(_mm_and_si128(first, on), _mm_andnot_si128(first, off)));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4), _mm_or_si128(_mm_and_si128(second, on), _mm_andnot_si128(second, off)));
+				out += 8;
+			}
+		}
+	}
+#else
+	for (int y = 0; y < height; y++) {
+		const U64* row = plane + y * stride;
+		for (int x = 0; x < words * 64; x++) {
+			*out++ = ((row[x / 64] >> (63 - x % 64)) & 1) != 0 ? onColor : offColor;
+		}
+	}
+#endif
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "OpCode.h"
+
+//Pixel art upscalers for the packed display plane, for output that is not drawn by the shader. The display has two
+//colors, so Scale2x and Scale3x only compare pixels for equality and work on 64 pixels at a time with bit operations.
+//Nothing is allocated, the caller passes the output.
+//
+//Planes hold words * 64 pixels per row with pixel x in bit 63 - x % 64 of word x / 64, rows are stride words apart.
+//Pixels past the edges repeat the edge pixels.
+
+//Scale2x, the same algorithm as EPX. Writes height * 2 rows of words * 2 words.
+void Scale2xPlane(const U64* plane, int stride, int words, int height, U64* out);
+//Writes height * 3 rows of words * 3 words
+void Scale3xPlane(const U64* plane, int stride, int words, int height, U64* out);
+
+//Writes words * 64 * height pixels, onColor for set pixels and offColor for clear ones
+void PlaneToRGBA(const U64* plane, int stride, int words, int height, U32 onColor, U32 offColor, U32* out);
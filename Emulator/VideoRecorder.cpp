@@ -0,0 +1,224 @@
+#include "VideoRecorder.h"
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+static void WriteU16(std::ostream& out, U16 value) {
+	U8 bytes[2] = { (U8)value, (U8)(value >> 8) };
+	out.write((const char*)bytes, 2);
+}
+
+static void WriteU32(std::ostream& out, U32 value) {
+	U8 bytes[4] = { (U8)value, (U8)(value >> 8), (U8)(value >> 16), (U8)(value >> 24) };
+	out.write((const char*)bytes, 4);
+}
+
+static bool ReadU16(std::istream& in, U16& value) {
+	U8 bytes[2];
+	if (!in.read((char*)bytes, 2))
+		return false;
+	value = (U16)(bytes[0] | (bytes[1] << 8));
+	return true;
+}
+
+static bool ReadU32(std::istream& in, U32& value) {
+	U8 bytes[4];
+	if (!in.read((char*)bytes, 4))
+		return false;
+	value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((U32)bytes[3] << 24);
+	return true;
+}
+
+VideoRecorder::VideoRecorder() : m_Stop(false), m_FramesWritten(0), m_FramesDropped(0), m_BytesWritten(0) {
+}
+
+VideoRecorder::~VideoRecorder() {
+	Stop();
+}
+
+bool VideoRecorder::Start(const char* path) {
+	Stop();
+	m_File.open(path, std::ios::binary | std::ios::trunc);
+	if (!m_File.is_open())
+		return false;
+
+	m_File.write("C8V1", 4);
+	WriteU16(m_File, PLANE_WORDS);
+	WriteU16(m_File, PLANE_ROWS);
+	memset(m_Previous, 0, sizeof(m_Previous));
+	m_FramesWritten = 0;
+	m_FramesDropped = 0;
+	m_BytesWritten = 8;
+
+	m_Stop = false;
+	m_Worker = std::thread(&VideoRecorder::Work, this);
+	return true;
+}
+
+void VideoRecorder::Stop() {
+	if (!m_Worker.joinable())
+		return;
+	m_Stop = true;
+	m_Wake.notify_one();
+	m_Worker.join();
+	m_File.close();
+}
+
+bool VideoRecorder::AddFrame(const U64* plane, int planeWords, int width, int height, U32 index) {
+	Frame* frame = m_Queue.Reserve();
+	if (frame == nullptr) {
+		m_FramesDropped++;
+		return false;
+	}
+
+	frame->index = index;
+	frame->width = (U16)width;
+	frame->height = (U16)height;
+	if (planeWords == PLANE_WORDS) {
+		memcpy(frame->plane, plane, sizeof(frame->plane));
+	} else {
+		//Smaller cores are widened to the recorded layout
+		memset(frame->plane, 0, sizeof(frame->plane));
+		for (int y = 0; y < height; y++) {
+			memcpy(frame->plane + y * PLANE_WORDS, plane + y * planeWords, planeWords * sizeof(U64));
+		}
+	}
+	m_Queue.Commit();
+
+	//Without the lock a wakeup can be missed, the worker also wakes up on its own
+	m_Wake.notify_one();
+	return true;
+}
+
+void VideoRecorder::Work() {
+	for (;;) {
+		Frame* frame = m_Queue.Front();
+		if (frame == nullptr) {
+			if (m_Stop)
+				break;
+			std::unique_lock<std::mutex> lock(m_WakeMutex);
+			m_Wake.wait_for(lock, std::chrono::milliseconds(10));
+			continue;
+		}
+		Write(*frame);
+		m_Queue.Pop();
+	}
+	m_File.flush();
+}
+
+void VideoRecorder::Write(const Frame& frame) {
+	m_Delta.clear();
+	EncodeDelta((const U8*)m_Previous, (const U8*)frame.plane, PLANE_BYTES, m_Delta);
+	memcpy(m_Previous, frame.plane, sizeof(m_Previous));
+
+	WriteU32(m_File, frame.index);
+	WriteU16(m_File, frame.width);
+	WriteU16(m_File, frame.height);
+	WriteU32(m_File, (U32)m_Delta.size());
+	m_File.write((const char*)m_Delta.data(), m_Delta.size());
+
+	m_FramesWritten++;
+	m_BytesWritten += 12 + m_Delta.size();
+}
+
+void VideoRecorder::EncodeDelta(const U8* previous, const U8* current, int size, std::vector<U8>& out) {
+	int i = 0;
+	while (i < size) {
+		//Unchanged bytes, runs of up to 128
+		int start = i;
+		while (i < size && i - start < 128 && previous[i] == current[i])
+			i++;
+		if (i > start) {
+			out.push_back((U8)(i - start - 1));
+			continue;
+		}
+
+		//Changed bytes up to the next pair of unchanged ones, a single unchanged byte costs less inside the literal
+		while (i < size && i - start < 128 && (previous[i] != current[i] || (i + 1 < size && previous[i + 1] != current[i + 1])))
+			i++;
+		out.push_back((U8)(0x7F + i - start));
+		for (int j = start; j < i; j++) {
+			out.push_back(previous[j] ^ current[j]);
+		}
+	}
+}
+
+bool VideoRecorder::ApplyDelta(const U8* delta, int deltaSize, U8* frame, int size) {
+	int position = 0;
+	int i = 0;
+	while (i < deltaSize) {
+		U8 control = delta[i++];
+		if (control < 0x80) {
+			position += control + 1;
+			if (position > size)
+				return false;
+		} else {
+			int count = control - 0x7F;
+			if (position + count > size || i + count > deltaSize)
+				return false;
+			for (int j = 0; j < count; j++) {
+				frame[position++] ^= delta[i++];
+			}
+		}
+	}
+	return position == size;
+}
+
+bool VideoRecorder::ConvertToY4m(const char* inputPath, const char* outputPath, int scale) {
+	std::ifstream in(inputPath, std::ios::binary);
+	char magic[4];
+	U16 words;
+	U16 rows;
+	if (!in.read(magic, 4) || memcmp(magic, "C8V1", 4) != 0 || !ReadU16(in, words) || !ReadU16(in, rows) || words != PLANE_WORDS || rows != PLANE_ROWS)
+		return false;
+	std::ofstream out(outputPath, std::ios::binary | std::ios::trunc);
+	if (!out.is_open() || scale <= 0)
+		return false;
+
+	const int maxWidth = PLANE_WORDS * 64;
+	int videoWidth = maxWidth * scale;
+	int videoHeight = PLANE_ROWS * scale;
+	std::ostringstream header;
+	header << "YUV4MPEG2 W" << videoWidth << " H" << videoHeight << " F60:1 Ip A1:1 C420jpeg\n";
+	out << header.str();
+
+	U64 plane[PLANE_WORDS * PLANE_ROWS] = {};
+	std::vector<U8> delta;
+	std::vector<U8> image(videoWidth * videoHeight * 3 / 2, 128);
+	bool first = true;
+	U32 lastIndex = 0;
+	U32 index;
+	U16 width;
+	U16 height;
+	U32 deltaSize;
+	while (ReadU32(in, index) && ReadU16(in, width) && ReadU16(in, height) && ReadU32(in, deltaSize)) {
+		delta.resize(deltaSize);
+		if (!in.read((char*)delta.data(), deltaSize) || !ApplyDelta(delta.data(), deltaSize, (U8*)plane, PLANE_BYTES))
+			return false;
+		if (width == 0 || height == 0 || width > maxWidth || height > PLANE_ROWS)
+			return false;
+
+		//Repeat the previous image until this frame is due
+		if (!first) {
+			for (U32 i = lastIndex + 1; i < index; i++) {
+				out << "FRAME\n";
+				out.write((const char*)image.data(), image.size());
+			}
+		}
+
+		//Luma only, a smaller display is stretched over the whole video
+		for (int y = 0; y < videoHeight; y++) {
+			int row = y * height / videoHeight;
+			for (int x = 0; x < videoWidth; x++) {
+				int column = x * width / videoWidth;
+				bool set = ((plane[row * PLANE_WORDS + column / 64] >> (63 - column % 64)) & 1) != 0;
+				image[y * videoWidth + x] = set ? 235 : 16;
+			}
+		}
+		out << "FRAME\n";
+		out.write((const char*)image.data(), image.size());
+		lastIndex = index;
+		first = false;
+	}
+	return out.good();
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "OpCode.h"
+#include "SpscQueue.h"
+
+//Records the display to a file on a worker thread. The frame loop adds a frame only when the display changed, which
+//copies the plane into a lock-free queue and never waits. When the worker falls behind and the queue is full the frame
+//is dropped and counted. The worker stores each frame as the XOR with the previous one, run length encoded, so a frame
+//where a few sprites moved takes a few dozen bytes.
+//
+//File layout, little endian:
+//	"C8V1", U16 words per row, U16 rows
+//	per frame: U32 frame index, U16 width, U16 height, U32 delta size, delta
+//A delta is a sequence of control bytes, each followed by its data: 0x00-0x7F is a run of control + 1 unchanged bytes,
+//0x80-0xFF is control - 0x7F bytes to XOR into the frame. Frames are planes of the largest display size, pixel x of
+//row y in bit 63 - x % 64 of word y * words per row + x / 64.
+struct VideoRecorder {
+	static const int PLANE_WORDS = 2;
+	static const int PLANE_ROWS = 64;
+	static const int PLANE_BYTES = PLANE_WORDS * PLANE_ROWS * 8;
+	static const int QUEUE_SIZE = 64;
+
+	struct Frame {
+		U32 index;
+		U16 width;
+		U16 height;
+		U64 plane[PLANE_WORDS * PLANE_ROWS];
+	};
+
+	SpscQueue<Frame, QUEUE_SIZE> m_Queue;
+	std::thread m_Worker;
+	std::atomic<bool> m_Stop;
+	//The worker sleeps here while the queue is empty
+	std::mutex m_WakeMutex;
+	std::condition_variable m_Wake;
+
+	std::ofstream m_File;
+	U64 m_Previous[PLANE_WORDS * PLANE_ROWS];
+	std::vector<U8> m_Delta;
+
+	std::atomic<U32> m_FramesWritten;
+	std::atomic<U32> m_FramesDropped;
+	std::atomic<U64> m_BytesWritten;
+
+	VideoRecorder();
+	~VideoRecorder();
+
+	bool Start(const char* path);
+	//Writes the queued frames and closes the file
+	void Stop();
+	bool IsRecording() const { return m_Worker.joinable(); }
+
+	//Frame loop side, index is the frame number the display is shown at. Returns false when the frame was dropped.
+	bool AddFrame(const U64* plane, int planeWords, int width, int height, U32 index);
+	template <class Emulator> bool AddFrame(const Emulator& emulator, U32 index) {
+		return AddFrame(emulator.m_Plane, Emulator::PLANE_WORDS, emulator.Width(), emulator.Height(), index);
+	}
+
+	//Appends the delta from previous to current, size bytes each
+	static void EncodeDelta(const U8* previous, const U8* current, int size, std::vector<U8>& out);
+	//Applies a delta to frame, false when it is malformed
+	static bool ApplyDelta(const U8* delta, int deltaSize, U8* frame, int size);
+	//Writes a recording as a 60 fps grayscale YUV4MPEG2 video, each display pixel scaled to scale x scale pixels of a
+	//largest size display. Frames between recorded ones repeat the last one.
+	static bool ConvertToY4m(const char* inputPath, const char* outputPath, int scale);
+
+private:
+	void Work();
+	void Write(const Frame& frame);
+};
@@ -1,12 +1,31 @@
 #include <iostream>
 #include <sstream>
 #include <Windows.h>
-#include <map>
+#include <functional>
 #include <sys/stat.h>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
 
 
 #include "Chip8.h"
 #include "SuperChip.h"
+#include "SuperChipJit.h"
+#include "BatchSuperChip.h"
+#include "Recompiler.h"
+#include "RecompiledRom.h"
+#include "FrameUploader.h"
+#include "CrtRenderer.h"
+#include "VideoRecorder.h"
+#include "FrameBlender.h"
+#include "Upscale.h"
+#include "TripleBuffer.h"
+#include "Scheduler.h"
+#include "KeyInput.h"
+#include "Beeper.h"
+#include "AudioOutput.h"
 
 // GLAD
 #include <glad/glad.h>
@@ -15,15 +34,9 @@
 #include <GLFW/glfw3.h>
 
 #define SHADER_DEBUGGING
-#define SUPERCHIP
-
-#define CHECK_KEY(key) if (glfwGetKey(window, key) == GLFW_PRESS) emulator.m_Key |= 1 << gKeyMap[key]
-
-#ifdef SUPERCHIP
-typedef SuperChip Emulator;
-#else
-typedef Chip8 Emulator;
-#endif
+//#define USE_JIT
+//Runs SuperChip roms through the recompiled code linked into the executable, see Recompiler.h
+//#define USE_RECOMPILED
 
 class LogBuf : public std::stringbuf {
 protected:
@@ -40,7 +53,6 @@ protected:
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode);
 void drop_callback(GLFWwindow* window, int count, const char** paths);
 
-void HandleInput(GLFWwindow *window);
 void printShaderLog(GLuint shader);
 GLuint LoadShaderFromFile(const std::string & filePath, GLenum shaderType);
 void ReloadShaderFromFile(const std::string & filePath, GLuint shaderID);
@@ -49,30 +61,108 @@ bool gIsShaderError = false;
 const GLuint WIDTH = 1024, HEIGHT = 512;
 
 
-std::map<int, U16> gKeyMap;
+KeyMap gKeyMap;
+//Key events from the window thread to the emulation thread
+KeyInput gKeyInput;
+
+//Colors of set and clear pixels as RGB, applied by the fragment shader
+U32 gOnColor = 0xFFFFFF;
+U32 gOffColor = 0x000000;
+//Frames combined against sprite flicker, 1 shows every frame as it is, see FrameBlender.h
+int gBlendFrames = 1;
+//Guest speed, the timers always run at 60 Hz. Turbo runs as fast as the host can and is toggled with Tab.
+U32 gInstructionsPerSecond = 300;
+std::atomic<bool> gTurbo(false);
+//Sound queued in ms when the audio output paces the emulator instead of the monotonic clock, 0 for the clock
+int gAudioPace = 0;
+//Frames emulated ahead of the shown one with the keys held now, hides games that react a few frames after reading keys
+int gRunAhead = 0;
+
+//Create emulators, the command line picks which one runs
+Chip8 gChip8;
+SuperChip gSuperChip;
+#if defined(USE_JIT)
+SuperChipJit gJit(gSuperChip);
+#elif defined(USE_RECOMPILED)
+RecompiledRunner gRecompiled(gSuperChip);
+#endif
+
+//Records the display when started with -record
+VideoRecorder gRecorder;
 
-//Create emulator;
-Emulator emulator;
+//The sound timer's beep, played on the audio device unless -audio picks another sink
+Beeper gBeeper;
+AudioOutput gAudio;
+
+//Loads a rom into the running emulator
+std::function<void(const char*)> gLoadRom;
+
+template <class Emulator>
+void RunEmulator(GLFWwindow* window, Emulator& emulator, const char* romPath, GLuint shaderProgram, GLuint fragmentShader);
+bool RenderThumbnail(const char* romPath, int frames, const char* outputPath, int width, int height);
+bool RenderSnapshot(const char* romPath, int frames, const char* outputPath, int scale);
+bool RenderSoundtrack(const char* romPath, int frames, const char* outputPath);
+void LogAudioStats(std::ostream& out, const Beeper::Stats& stats);
+void BenchmarkUpscale(int iterations);
+bool BenchmarkBatch(const char* romPath, int lanes, int frames, int instructionsPerFrame);
 
 
 int main(int argc, char* argv[]) {
+	//Usage: Emulator -recompile <rom> <output.cpp>, writes the rom as C++ source and exits
+	if (argc == 4 && strcmp(argv[1], "-recompile") == 0) {
+		Recompiler recompiler;
+		return recompiler.Recompile(argv[2], argv[3]) ? 0 : 1;
+	}
+	//Usage: Emulator -thumbnail <rom> <frames> <output.tga> [width height] [blend frames], renders the display after
+	//frames frames without a window or GPU
+	if ((argc == 5 || argc == 7 || argc == 8) && strcmp(argv[1], "-thumbnail") == 0) {
+		if (argc == 8)
+			gBlendFrames = atoi(argv[7]);
+		return RenderThumbnail(argv[2], atoi(argv[3]), argv[4], argc >= 7 ? atoi(argv[5]) : WIDTH, argc >= 7 ? atoi(argv[6]) : HEIGHT) ? 0 : 1;
+	}
+	//Usage: Emulator -snapshot <rom> <frames> <output.tga> [scale], writes the display after frames frames in the palette
+	//colors, enlarged with Scale2x or Scale3x for a scale of 2 or 3
+	if ((argc == 5 || argc == 6) && strcmp(argv[1], "-snapshot") == 0) {
+		return RenderSnapshot(argv[2], atoi(argv[3]), argv[4], argc == 6 ? atoi(argv[5]) : 1) ? 0 : 1;
+	}
+	//Usage: Emulator -benchscale [iterations], times the upscalers on both display sizes
+	if ((argc == 2 || argc == 3) && strcmp(argv[1], "-benchscale") == 0) {
+		BenchmarkUpscale(argc == 3 ? atoi(argv[2]) : 10000);
+		return 0;
+	}
+	//Usage: Emulator -benchbatch <rom> [lanes] [frames] [instructions per frame], runs the lanes as separate SuperChips and
+	//in a BatchSuperChip on every path the CPU supports with the same keys, fails if a lane differs after any frame
+	if (argc >= 3 && argc <= 6 && strcmp(argv[1], "-benchbatch") == 0) {
+		return BenchmarkBatch(argv[2], argc >= 4 ? atoi(argv[3]) : 70, argc >= 5 ? atoi(argv[4]) : 600,
+			argc >= 6 ? atoi(argv[5]) : 10) ? 0 : 1;
+	}
+	//Usage: Emulator -soundtrack <rom> <frames> <output.wav>, writes the beeps of the first frames frames without a
+	//window or audio device
+	if (argc == 5 && strcmp(argv[1], "-soundtrack") == 0) {
+		return RenderSoundtrack(argv[2], atoi(argv[3]), argv[4]) ? 0 : 1;
+	}
+	//Usage: Emulator -y4m <recording> <output.y4m> [scale], converts a -record file to a video
+	if ((argc == 4 || argc == 5) && strcmp(argv[1], "-y4m") == 0) {
+		return VideoRecorder::ConvertToY4m(argv[2], argv[3], argc == 5 ? atoi(argv[4]) : 4) ? 0 : 1;
+	}
+
 	//Set keys
-	gKeyMap.insert(std::make_pair(GLFW_KEY_1, 0x1));
-	gKeyMap.insert(std::make_pair(GLFW_KEY_2, 0x2));
-	gKeyMap.insert(std::make_pair(GLFW_KEY_3, 0x3));
-	gKeyMap.insert(std::make_pair(GLFW_KEY_4, 0xC));
-	gKeyMap.insert(std::make_pair(GLFW_KEY_Q, 0x4));
-	gKeyMap.insert(std::make_pair(GLFW_KEY_W, 0x5));
-	gKeyMap.insert(std::make_pair(GLFW_KEY_E, 0x6));
-	gKeyMap.insert(std::make_pair(GLFW_KEY_R, 0xD));
-	gKeyMap.insert(std::make_pair(GLFW_KEY_A, 0x7));
-	gKeyMap.insert(std::make_pair(GLFW_KEY_S, 0x8));
-	gKeyMap.insert(std::make_pair(GLFW_KEY_D, 0x9));
-	gKeyMap.insert(std::make_pair(GLFW_KEY_F, 0xE));
-	gKeyMap.insert(std::make_pair(GLFW_KEY_Z, 0xA));
-	gKeyMap.insert(std::make_pair(GLFW_KEY_X, 0x0));
-	gKeyMap.insert(std::make_pair(GLFW_KEY_C, 0xB));
-	gKeyMap.insert(std::make_pair(GLFW_KEY_V, 0xF));
+	gKeyMap.Set(GLFW_KEY_1, 0x1);
+	gKeyMap.Set(GLFW_KEY_2, 0x2);
+	gKeyMap.Set(GLFW_KEY_3, 0x3);
+	gKeyMap.Set(GLFW_KEY_4, 0xC);
+	gKeyMap.Set(GLFW_KEY_Q, 0x4);
+	gKeyMap.Set(GLFW_KEY_W, 0x5);
+	gKeyMap.Set(GLFW_KEY_E, 0x6);
+	gKeyMap.Set(GLFW_KEY_R, 0xD);
+	gKeyMap.Set(GLFW_KEY_A, 0x7);
+	gKeyMap.Set(GLFW_KEY_S, 0x8);
+	gKeyMap.Set(GLFW_KEY_D, 0x9);
+	gKeyMap.Set(GLFW_KEY_F, 0xE);
+	gKeyMap.Set(GLFW_KEY_Z, 0xA);
+	gKeyMap.Set(GLFW_KEY_X, 0x0);
+	gKeyMap.Set(GLFW_KEY_C, 0xB);
+	gKeyMap.Set(GLFW_KEY_V, 0xF);
 
 
 	//Set debugging log
@@ -160,15 +250,6 @@ int main(int argc, char* argv[]) {
 
 	glfwSwapInterval(1);
 
-#ifdef SUPERCHIP
-	emulator.SetExitCallback([&]() {glfwSetWindowShouldClose(window, GL_TRUE); });
-#endif
-
-	if (argc > 1) {
-		emulator.LoadRom(argv[1]);
-	}
-	srand(GetTickCount());
-
 	// Set the required callback functions
 	glfwSetKeyCallback(window, key_callback);
 	glfwSetDropCallback(window, drop_callback);
@@ -185,6 +266,284 @@ int main(int argc, char* argv[]) {
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
 
+	srand(GetTickCount());
+
+	//Usage: Emulator [-chip8] [-palette <on RRGGBB> <off RRGGBB>] [-blend <frames>] [-ips <instructions per second>]
+	//[-turbo] [-runahead <frames>] [-record <file>] [-audio <device|null|none|file.wav>] [-audiopace <ms>] [rom], runs
+	//SuperChip unless -chip8 is given. -audiopace paces the emulator from the audio output, keeping ms of sound queued.
+	bool chip8Mode = false;
+	const char* romPath = NULL;
+	const char* audio = "device";
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-chip8") == 0) {
+			chip8Mode = true;
+		} else if (strcmp(argv[i], "-palette") == 0 && i + 2 < argc) {
+			gOnColor = strtoul(argv[i + 1], NULL, 16);
+			gOffColor = strtoul(argv[i + 2], NULL, 16);
+			i += 2;
+		} else if (strcmp(argv[i], "-blend") == 0 && i + 1 < argc) {
+			gBlendFrames = atoi(argv[i + 1]);
+			i++;
+		} else if (strcmp(argv[i], "-ips") == 0 && i + 1 < argc) {
+			gInstructionsPerSecond = strtoul(argv[i + 1], NULL, 10);
+			i++;
+		} else if (strcmp(argv[i], "-turbo") == 0) {
+			gTurbo = true;
+		} else if (strcmp(argv[i], "-runahead") == 0 && i + 1 < argc) {
+			gRunAhead = atoi(argv[i + 1]);
+			i++;
+		} else if (strcmp(argv[i], "-record") == 0 && i + 1 < argc) {
+			if (!gRecorder.Start(argv[i + 1]))
+				std::cout << "Failed to open " << argv[i + 1] << std::endl;
+			i++;
+		} else if (strcmp(argv[i], "-audio") == 0 && i + 1 < argc) {
+			audio = argv[i + 1];
+			i++;
+		} else if (strcmp(argv[i], "-audiopace") == 0 && i + 1 < argc) {
+			gAudioPace = atoi(argv[i + 1]);
+			i++;
+		} else {
+			romPath = argv[i];
+		}
+	}
+
+	if (strcmp(audio, "none") != 0) {
+		bool started;
+		if (strcmp(audio, "device") == 0)
+			started = gAudio.Start(gBeeper, AudioOutput::SINK_DEVICE);
+		else if (strcmp(audio, "null") == 0)
+			started = gAudio.Start(gBeeper, AudioOutput::SINK_NULL);
+		else
+			started = gAudio.Start(gBeeper, AudioOutput::SINK_WAV, audio);
+		if (!started)
+			std::cout << "Failed to open audio " << audio << ", running without sound" << std::endl;
+	}
+
+	if (chip8Mode)
+		RunEmulator(window, gChip8, romPath, shaderProgram, fragmentShader);
+	else
+		RunEmulator(window, gSuperChip, romPath, shaderProgram, fragmentShader);
+
+	if (gRecorder.IsRecording()) {
+		gRecorder.Stop();
+		std::cout << "Recorded " << gRecorder.m_FramesWritten << " frames in " << gRecorder.m_BytesWritten << " bytes, dropped "
+			<< gRecorder.m_FramesDropped << std::endl;
+	}
+	if (gAudio.IsRunning()) {
+		gAudio.Stop();
+		LogAudioStats(std::cout, gBeeper.TakeStats());
+	}
+
+	// Terminates GLFW, clearing any resources allocated by GLFW.
+	glfwTerminate();
+	return 0;
+}
+
+template <class Emulator>
+U32 Execute(Emulator& emulator, int cycles) {
+	return emulator.RunCycles(cycles);
+}
+
+template <class Emulator>
+U32 ExecuteUntil(Emulator& emulator, U32 stopEvents, int maxCycles, int* executed) {
+	return emulator.RunUntil(stopEvents, maxCycles, executed);
+}
+
+#if defined(USE_JIT)
+template <>
+U32 Execute(SuperChip& emulator, int cycles) {
+	UNREFERENCED_PARAMETER(emulator);
+	return gJit.Run(cycles);
+}
+
+template <>
+U32 ExecuteUntil(SuperChip& emulator, U32 stopEvents, int maxCycles, int* executed) {
+	UNREFERENCED_PARAMETER(emulator);
+	return gJit.RunUntil(stopEvents, maxCycles, executed);
+}
+#elif defined(USE_RECOMPILED)
+template <>
+U32 Execute(SuperChip& emulator, int cycles) {
+	UNREFERENCED_PARAMETER(emulator);
+	return gRecompiled.Run(cycles);
+}
+
+template <>
+U32 ExecuteUntil(SuperChip& emulator, U32 stopEvents, int maxCycles, int* executed) {
+	UNREFERENCED_PARAMETER(emulator);
+	return gRecompiled.RunUntil(stopEvents, maxCycles, executed);
+}
+#endif
+
+//Runs cycles instructions like Execute, but stops wherever FX18 starts or stops the sound for sound(done) to switch the
+//beep after the done instructions run so far
+template <class Emulator, class Sound>
+void ExecuteSound(Emulator& emulator, int cycles, Sound sound) {
+	int done = 0;
+	while (done < cycles) {
+		int executed = 0;
+		U32 events = ExecuteUntil(emulator, EVENT_EXIT | EVENT_SOUND_START | EVENT_SOUND_STOP, cycles - done, &executed);
+		done += executed;
+		sound(done);
+		if ((events & EVENT_EXIT) != 0 || executed == 0)
+			break;
+	}
+}
+
+//A finished frame of the emulation thread
+template <class Emulator>
+struct DisplayFrame {
+	U64 plane[Emulator::PLANE_WORDS * Emulator::MAX_HEIGHT];
+	int width;
+	int height;
+	//Rows that may differ from the frame the render thread took before this one
+	U64 dirtyRows;
+};
+
+template <class Emulator>
+void RunEmulator(GLFWwindow* window, Emulator& emulator, const char* romPath, GLuint shaderProgram, GLuint fragmentShader) {
+	//Emulation runs on its own thread at the guest rate and hands each changed frame to this thread through a triple
+	//buffer. A slow buffer swap no longer holds up the emulator, and the emulator never waits for the display.
+	TripleBuffer<DisplayFrame<Emulator>> frames;
+	std::atomic<bool> stop(false);
+	std::atomic<bool> exitRequested(false);
+	//Set while the emulation thread runs frames that are thrown away, a rom exiting there does not count
+	bool runningAhead = false;
+	//Roms dropped on the window are loaded by the emulation thread between two frames
+	std::mutex romMutex;
+	std::string pendingRom;
+	std::atomic<bool> romPending(false);
+
+	emulator.SetExitCallback([&]() {
+		if (!runningAhead)
+			exitRequested = true;
+	});
+	gLoadRom = [&](const char* path) {
+		std::lock_guard<std::mutex> lock(romMutex);
+		pendingRom = path;
+		romPending = true;
+	};
+
+	if (romPath != NULL) {
+		emulator.LoadRom(romPath);
+	}
+
+	std::thread emulation([&]() {
+		FrameBlender blender(Emulator::PLANE_WORDS, Emulator::MAX_HEIGHT, gBlendFrames);
+		Scheduler scheduler(gInstructionsPerSecond);
+		//With -audiopace the audio output runs the ticks, the display still takes the newest frame when it presents
+		if (gAudioPace > 0 && gAudio.IsRunning()) {
+			int targetFill = gAudioPace * Beeper::SAMPLE_RATE / 1000;
+			scheduler.SetAudioClock(&gBeeper, targetFill > Beeper::TICK_SAMPLES ? targetFill : Beeper::TICK_SAMPLES);
+		}
+		//Rows the render thread may not have, all of them until it takes a first frame
+		U64 unseenRows = ~(U64)0;
+		int lastWidth = 0;
+		int lastHeight = 0;
+		U32 frame = 0;
+		//Run-ahead shows a copy of the display of the frame ahead, compared with the last one to find the changed rows
+		typename Emulator::State saved;
+		U64 ahead[Emulator::PLANE_WORDS * Emulator::MAX_HEIGHT] = {};
+		std::chrono::steady_clock::time_point tickStart = std::chrono::steady_clock::now();
+
+		while (!stop && !exitRequested) {
+			if (romPending) {
+				std::lock_guard<std::mutex> lock(romMutex);
+				emulator.LoadRom(pendingRom);
+				romPending = false;
+			}
+
+			frame++;
+			scheduler.SetTurbo(gTurbo);
+			emulator.DecreaseTimers();
+			// The instructions of this tick stand for the time since the last one, key events land between them by time
+			std::chrono::steady_clock::time_point tickEnd = std::chrono::steady_clock::now();
+			int tickInstructions = scheduler.NextTickInstructions();
+			if (gAudio.IsRunning()) {
+				// The beep follows the sound timer to the instruction, placed in the tick's samples like the key events
+				int tickDone = 0;
+				gBeeper.SetTone(emulator.m_TimerSound != 0, 0, tickInstructions);
+				gKeyInput.RunTick(emulator.m_Key, tickInstructions, tickStart, tickEnd, [&](int instructions) {
+					ExecuteSound(emulator, instructions, [&](int done) {
+						gBeeper.SetTone(emulator.m_TimerSound != 0, tickDone + done, tickInstructions);
+					});
+					tickDone += instructions;
+				});
+				gBeeper.EndTick();
+			} else {
+				gKeyInput.RunTick(emulator.m_Key, tickInstructions, tickStart, tickEnd, [&](int instructions) {
+					Execute(emulator, instructions);
+				});
+			}
+			tickStart = tickEnd;
+
+			int width = emulator.Width();
+			int height = emulator.Height();
+			U64 dirtyRows = emulator.TakeDirtyRows();
+			const U64* plane = emulator.m_Plane;
+
+			// Run ahead from a snapshot and show that frame instead, then go back to the real one
+			if (gRunAhead > 0) {
+				emulator.SaveState(saved);
+				runningAhead = true;
+				for (int i = 0; i < gRunAhead; i++) {
+					emulator.DecreaseTimers();
+					Execute(emulator, scheduler.PeekTickInstructions(i));
+				}
+				runningAhead = false;
+				width = emulator.Width();
+				height = emulator.Height();
+				//Rows past the display are not shown, they stay as they were and are compared once the display grows again
+				dirtyRows = 0;
+				for (int y = 0; y < height; y++) {
+					const U64* row = emulator.m_Plane + y * Emulator::PLANE_WORDS;
+					if (memcmp(ahead + y * Emulator::PLANE_WORDS, row, sizeof(U64) * Emulator::PLANE_WORDS) != 0) {
+						memcpy(ahead + y * Emulator::PLANE_WORDS, row, sizeof(U64) * Emulator::PLANE_WORDS);
+						dirtyRows |= (U64)1 << y;
+					}
+				}
+				plane = ahead;
+				emulator.LoadState(saved);
+			}
+
+			// The blended display replaces the core's one from here on, for the screen and the recording
+			if (blender.Frames() > 1) {
+				dirtyRows = blender.Blend(plane, dirtyRows);
+				plane = blender.Plane();
+			}
+			dirtyRows &= Emulator::RowMask(height);
+			bool resized = width != lastWidth || height != lastHeight;
+			lastWidth = width;
+			lastHeight = height;
+
+			// Frames that change nothing are neither recorded nor shown, the frame number keeps the timing
+			if (dirtyRows != 0 || resized) {
+				if (gRecorder.IsRecording())
+					gRecorder.AddFrame(plane, Emulator::PLANE_WORDS, width, height, frame);
+
+				DisplayFrame<Emulator>& display = frames.Back();
+				memcpy(display.plane, plane, sizeof(display.plane));
+				display.width = width;
+				display.height = height;
+				display.dirtyRows = unseenRows | dirtyRows;
+				U64 publishedRows = display.dirtyRows;
+				// Once the render thread took the previous frame it is at most this frame behind. Otherwise it was already
+				// woken up for that frame, which matters in turbo mode.
+				if (frames.Publish()) {
+					unseenRows = dirtyRows;
+					glfwPostEmptyEvent();
+				} else {
+					unseenRows = publishedRows;
+				}
+			}
+
+			scheduler.WaitForTick();
+		}
+		glfwPostEmptyEvent();
+	});
+
+	//Log the audio latency every few seconds
+	std::chrono::steady_clock::time_point lastAudioLog = std::chrono::steady_clock::now();
 
 #ifdef SHADER_DEBUGGING
 	struct stat buf;
@@ -192,19 +551,55 @@ int main(int argc, char* argv[]) {
 	int lastShaderModification = (int)buf.st_mtime;
 #endif
 
+	//The texture holds m_Plane as it is in memory, a byte of 8 pixels per texel. It is allocated once at the largest
+	//display size, the active display is its top left corner and displaySize tells the shader how much of it is in use.
+	const int planeBytes = Emulator::PLANE_WORDS * sizeof(U64);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, planeBytes, Emulator::MAX_HEIGHT, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, NULL);
+	FrameUploader uploader(planeBytes, Emulator::MAX_HEIGHT, 1, GL_RED_INTEGER, GL_UNSIGNED_BYTE);
+	//Log the average upload timing every 60 uploads
+	FrameUploader::Timing timingSum = FrameUploader::Timing();
+	int timingFrames = 0;
+	int gpuFrames = 0;
+	uploader.SetTimingCallback([&](const FrameUploader::Timing& timing) {
+		timingSum.wait += timing.wait;
+		timingSum.write += timing.write;
+		timingSum.submit += timing.submit;
+		if (timing.gpu >= 0) {
+			timingSum.gpu += timing.gpu;
+			gpuFrames++;
+		}
+		if (++timingFrames == 60) {
+			std::clog << "Upload us: wait " << timingSum.wait * 1e6 / timingFrames << ", write " << timingSum.write * 1e6 / timingFrames
+				<< ", submit " << timingSum.submit * 1e6 / timingFrames << ", gpu " << (gpuFrames != 0 ? timingSum.gpu * 1e6 / gpuFrames : 0) << std::endl;
+			timingSum = FrameUploader::Timing();
+			timingFrames = 0;
+			gpuFrames = 0;
+		}
+	});
+	auto setPalette = [&]() {
+		glUniform3f(glGetUniformLocation(shaderProgram, "onColor"), (gOnColor >> 16 & 0xFF) / 255.0f, (gOnColor >> 8 & 0xFF) / 255.0f, (gOnColor & 0xFF) / 255.0f);
+		glUniform3f(glGetUniformLocation(shaderProgram, "offColor"), (gOffColor >> 16 & 0xFF) / 255.0f, (gOffColor >> 8 & 0xFF) / 255.0f, (gOffColor & 0xFF) / 255.0f);
+	};
+	setPalette();
+	GLint displaySizeLocation = glGetUniformLocation(shaderProgram, "displaySize");
+	int displayWidth = 0;
+	int displayHeight = 0;
+	//Nothing is drawn until the first frame arrives
+	bool redraw = false;
+
 	// Game loop
 	while (!glfwWindowShouldClose(window)) {
 
-		// Check if any events have been activated (key pressed, mouse moved etc.) and call corresponding response functions
-		glfwPollEvents();
+		// Sleep until an event arrives, the emulation thread posts an empty one for each new frame. Keys go straight to
+		// the emulation thread from key_callback. The timeout keeps the shader file polled.
+		glfwWaitEventsTimeout(0.25);
+		if (exitRequested)
+			glfwSetWindowShouldClose(window, GL_TRUE);
 
-		HandleInput(window);
-		emulator.DecreaseTimers();
-		for (int i = 0; i < 5; i++) {
-			//loop emulator
-			emulator.Loop();
+		if (gAudio.IsRunning() && std::chrono::steady_clock::now() - lastAudioLog >= std::chrono::seconds(5)) {
+			lastAudioLog = std::chrono::steady_clock::now();
+			LogAudioStats(std::clog, gBeeper.TakeStats());
 		}
-		emulator.m_Key = 0;
 
 #ifdef SHADER_DEBUGGING
 		stat("Resources/fragmentShader.glsl", &buf);
@@ -212,17 +607,44 @@ int main(int argc, char* argv[]) {
 			lastShaderModification = (int)buf.st_mtime;
 			ReloadShaderFromFile("Resources/fragmentShader.glsl", fragmentShader);
 			glLinkProgram(shaderProgram);
+			setPalette();
+			displaySizeLocation = glGetUniformLocation(shaderProgram, "displaySize");
+			glUniform2f(displaySizeLocation, (GLfloat)displayWidth, (GLfloat)displayHeight);
+			redraw = true;
 		}
 #endif
 
-#ifdef SUPERCHIP
-		if (emulator.m_Extended)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 128, 64, 0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, (GLvoid*)emulator.m_Gfx);
-		else
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 64, 32, 0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, (GLvoid*)emulator.m_Gfx);
-#else
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 64, 32, 0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, (GLvoid*)emulator.m_Texture);
-#endif
+		if (frames.Update()) {
+			const DisplayFrame<Emulator>& frame = frames.Front();
+			int height = frame.height;
+			if (frame.width != displayWidth || height != displayHeight) {
+				displayWidth = frame.width;
+				displayHeight = height;
+				glUniform2f(displaySizeLocation, (GLfloat)displayWidth, (GLfloat)displayHeight);
+			}
+
+			// Copy each run of changed rows straight into the upload buffer
+			U64 dirtyRows = frame.dirtyRows & Emulator::RowMask(height);
+			if (dirtyRows != 0) {
+				U8* rows = uploader.Map();
+				for (int y = 0; y < height; y++) {
+					if (((dirtyRows >> y) & 1) == 0)
+						continue;
+					int first = y;
+					while (y + 1 < height && ((dirtyRows >> (y + 1)) & 1) != 0)
+						y++;
+					memcpy(rows + first * planeBytes, frame.plane + first * Emulator::PLANE_WORDS, (y + 1 - first) * planeBytes);
+					uploader.AddRows(first, y + 1 - first);
+				}
+				uploader.Upload();
+			}
+			redraw = true;
+		}
+
+		// Nothing changed on screen, no need to present the same frame again
+		if (!redraw)
+			continue;
+		redraw = false;
 
 		// Render
 		// Clear the screen to white
@@ -236,32 +658,243 @@ int main(int argc, char* argv[]) {
 		glfwSwapBuffers(window);
 	}
 
-	// Terminates GLFW, clearing any resources allocated by GLFW.
-	glfwTerminate();
-	return 0;
+	stop = true;
+	emulation.join();
+	gLoadRom = [](const char*) {};
 }
 
-#pragma region Input
+//Runs a rom for frames ticks of the timers, without input or waiting
+void RunHeadless(const char* romPath, int frames, FrameBlender& blender) {
+	gSuperChip.SetExitCallback([]() {});
+	gSuperChip.LoadRom(romPath);
+	Scheduler scheduler(gInstructionsPerSecond);
+	for (int i = 0; i < frames; i++) {
+		gSuperChip.DecreaseTimers();
+		gSuperChip.RunCycles(scheduler.NextTickInstructions());
+		blender.Blend(gSuperChip.m_Plane, gSuperChip.TakeDirtyRows());
+	}
+}
 
-void HandleInput(GLFWwindow* window) {
-	CHECK_KEY(GLFW_KEY_1);
-	CHECK_KEY(GLFW_KEY_2);
-	CHECK_KEY(GLFW_KEY_3);
-	CHECK_KEY(GLFW_KEY_4);
-	CHECK_KEY(GLFW_KEY_Q);
-	CHECK_KEY(GLFW_KEY_W);
-	CHECK_KEY(GLFW_KEY_E);
-	CHECK_KEY(GLFW_KEY_R);
-	CHECK_KEY(GLFW_KEY_A);
-	CHECK_KEY(GLFW_KEY_S);
-	CHECK_KEY(GLFW_KEY_D);
-	CHECK_KEY(GLFW_KEY_F);
-	CHECK_KEY(GLFW_KEY_Z);
-	CHECK_KEY(GLFW_KEY_X);
-	CHECK_KEY(GLFW_KEY_C);
-	CHECK_KEY(GLFW_KEY_V);
+bool RenderSoundtrack(const char* romPath, int frames, const char* outputPath) {
+	WavWriter wav;
+	if (!wav.Open(outputPath))
+		return false;
+
+	//The same beeper as the emulation thread, drained after every tick instead of by an audio callback
+	static Beeper beeper;
+	gSuperChip.SetExitCallback([]() {});
+	gSuperChip.LoadRom(romPath);
+	Scheduler scheduler(gInstructionsPerSecond);
+	short samples[Beeper::TICK_SAMPLES];
+	for (int i = 0; i < frames; i++) {
+		gSuperChip.DecreaseTimers();
+		int instructions = scheduler.NextTickInstructions();
+		beeper.SetTone(gSuperChip.m_TimerSound != 0, 0, instructions);
+		ExecuteSound(gSuperChip, instructions, [&](int done) {
+			beeper.SetTone(gSuperChip.m_TimerSound != 0, done, instructions);
+		});
+		beeper.EndTick();
+		beeper.Read(samples, Beeper::TICK_SAMPLES);
+		wav.Write(samples, Beeper::TICK_SAMPLES);
+	}
+	return wav.Close();
 }
 
+void LogAudioStats(std::ostream& out, const Beeper::Stats& stats) {
+	out << "Audio: " << stats.callbacks << " callbacks every " << stats.callbackInterval * 1e3 << " ms (max "
+		<< stats.maxCallbackInterval * 1e3 << "), ring latency " << stats.ringLatency * 1e3 << " ms (max " << stats.maxRingLatency * 1e3
+		<< "), underrun " << stats.underruns << " samples, overrun " << stats.overruns << std::endl;
+}
+
+bool RenderThumbnail(const char* romPath, int frames, const char* outputPath, int width, int height) {
+	if (width <= 0 || height <= 0)
+		return false;
+
+	FrameBlender blender(SuperChip::PLANE_WORDS, SuperChip::MAX_HEIGHT, gBlendFrames);
+	RunHeadless(romPath, frames, blender);
+
+	CrtRenderer renderer(width, height);
+	renderer.SetPalette(gOnColor, gOffColor);
+	std::vector<U8> pixels(width * height * 4);
+	renderer.Render(blender.Plane(), SuperChip::PLANE_WORDS, gSuperChip.Width(), gSuperChip.Height(), pixels.data());
+	return CrtRenderer::WriteTga(outputPath, pixels.data(), width, height);
+}
+
+//RRGGBB as the R, G, B, A bytes of a pixel
+U32 ToPixel(U32 color) {
+	U8 bytes[4] = { (U8)(color >> 16), (U8)(color >> 8), (U8)color, 0xFF };
+	U32 pixel;
+	memcpy(&pixel, bytes, sizeof(pixel));
+	return pixel;
+}
+
+bool RenderSnapshot(const char* romPath, int frames, const char* outputPath, int scale) {
+	if (scale < 1 || scale > 3)
+		return false;
+
+	FrameBlender blender(SuperChip::PLANE_WORDS, SuperChip::MAX_HEIGHT, gBlendFrames);
+	RunHeadless(romPath, frames, blender);
+
+	int words = gSuperChip.Width() / 64;
+	int height = gSuperChip.Height();
+	const U64* plane = blender.Plane();
+	int stride = SuperChip::PLANE_WORDS;
+	static U64 scaled[SuperChip::PLANE_WORDS * 3 * SuperChip::MAX_HEIGHT * 3];
+	if (scale == 2) {
+		Scale2xPlane(plane, stride, words, height, scaled);
+	} else if (scale == 3) {
+		Scale3xPlane(plane, stride, words, height, scaled);
+	}
+	if (scale != 1) {
+		plane = scaled;
+		stride = words * scale;
+	}
+
+	int width = words * 64 * scale;
+	std::vector<U32> pixels(width * height * scale);
+	PlaneToRGBA(plane, stride, words * scale, height * scale, ToPixel(gOnColor), ToPixel(gOffColor), pixels.data());
+	return CrtRenderer::WriteTga(outputPath, (const U8*)pixels.data(), width, height * scale);
+}
+
+void BenchmarkUpscale(int iterations) {
+	static U64 plane[SuperChip::PLANE_WORDS * SuperChip::MAX_HEIGHT];
+	static U64 scaled[SuperChip::PLANE_WORDS * 3 * SuperChip::MAX_HEIGHT * 3];
+	static U32 pixels[SuperChip::MAX_WIDTH * 3 * SuperChip::MAX_HEIGHT * 3];
+	for (int i = 0; i < SuperChip::PLANE_WORDS * SuperChip::MAX_HEIGHT; i++) {
+		plane[i] = ((U64)rand() << 42) ^ ((U64)rand() << 21) ^ rand();
+	}
+
+	//The Chip8 display and the SuperChip high resolution display
+	for (int words = 1; words <= 2; words++) {
+		int height = words * 32;
+		for (int scale = 2; scale <= 3; scale++) {
+			auto start = std::chrono::steady_clock::now();
+			for (int i = 0; i < iterations; i++) {
+				if (scale == 2)
+					Scale2xPlane(plane, SuperChip::PLANE_WORDS, words, height, scaled);
+				else
+					Scale3xPlane(plane, SuperChip::PLANE_WORDS, words, height, scaled);
+			}
+			auto scaledTime = std::chrono::steady_clock::now();
+			for (int i = 0; i < iterations; i++) {
+				PlaneToRGBA(scaled, words * scale, words * scale, height * scale, 0xFFFFFFFF, 0xFF000000, pixels);
+			}
+			auto end = std::chrono::steady_clock::now();
+			std::cout << words * 64 << "x" << height << " Scale" << scale << "x: "
+				<< std::chrono::duration<double, std::micro>(scaledTime - start).count() / iterations << " us, to RGBA "
+				<< std::chrono::duration<double, std::micro>(end - scaledTime).count() / iterations << " us" << std::endl;
+		}
+	}
+}
+
+//Compares field by field, the padding between the fields is not part of the state
+static bool SameState(const SuperChip::State& a, const SuperChip::State& b) {
+	return memcmp(a.m_Memory, b.m_Memory, sizeof(a.m_Memory)) == 0 && memcmp(a.m_Reg, b.m_Reg, sizeof(a.m_Reg)) == 0
+		&& a.m_RegI == b.m_RegI && (a.m_RegPC & 0xFFF) == (b.m_RegPC & 0xFFF)
+		&& memcmp(a.m_RPLUserFlags, b.m_RPLUserFlags, sizeof(a.m_RPLUserFlags)) == 0
+		&& memcmp(a.m_Plane, b.m_Plane, sizeof(a.m_Plane)) == 0 && a.m_TimerDelay == b.m_TimerDelay
+		&& a.m_TimerSound == b.m_TimerSound && a.m_Key == b.m_Key && memcmp(a.m_Stack, b.m_Stack, sizeof(a.m_Stack)) == 0
+		&& a.m_StackPointer == b.m_StackPointer && a.m_DirtyRows == b.m_DirtyRows && a.m_Extended == b.m_Extended
+		&& a.m_Random == b.m_Random;
+}
+
+bool BenchmarkBatch(const char* romPath, int lanes, int frames, int instructionsPerFrame) {
+	if (lanes < 1 || frames < 1 || instructionsPerFrame < 1)
+		return false;
+
+	//Pairs of lanes share a seed and their keys so some lanes stay together, the others diverge
+	std::vector<std::unique_ptr<SuperChip>> cores;
+	SuperChip::State state;
+	for (int lane = 0; lane < lanes; lane++) {
+		cores.emplace_back(new SuperChip());
+		cores[lane]->SetExitCallback([]() {});
+		cores[lane]->LoadRom(romPath);
+		cores[lane]->m_Random = 1000 + lane / 2;
+	}
+
+	const char* pathNames[] = { "scalar", "SSE2", "AVX2" };
+	std::vector<std::unique_ptr<BatchSuperChip>> batches;
+	for (int path = BATCH_SCALAR; path <= BATCH_AVX2; path++) {
+		std::unique_ptr<BatchSuperChip> batch(new BatchSuperChip(lanes));
+		batch->SetPath((BatchPath)path);
+		if (batch->Path() != path)
+			continue;
+		for (int lane = 0; lane < lanes; lane++) {
+			cores[lane]->SaveState(state);
+			if (lane == 0)
+				batch->Load(state);
+			batch->LoadLane(lane, state);
+		}
+		batches.push_back(std::move(batch));
+	}
+
+	typedef std::chrono::steady_clock Clock;
+	Clock::duration coreTime(0);
+	std::vector<Clock::duration> batchTimes(batches.size(), Clock::duration(0));
+	U32 random = 1;
+	for (int frame = 0; frame < frames; frame++) {
+		//A key in a quarter of the frames
+		U16 keys = 0;
+		for (int lane = 0; lane < lanes; lane++) {
+			if (lane % 2 == 0) {
+				random = random * 1664525 + 1013904223;
+				keys = (random >> 30) == 0 ? (U16)(1 << ((random >> 8) & 0xF)) : 0;
+			}
+			cores[lane]->m_Key = keys;
+			for (auto& batch : batches)
+				batch->SetKeys(lane, keys);
+		}
+
+		//A lane stops for good at 00FD, the core it is checked against stops with it
+		auto start = Clock::now();
+		for (int lane = 0; lane < lanes; lane++) {
+			if (batches.empty() || !batches[0]->Exited(lane)) {
+				cores[lane]->DecreaseTimers();
+				cores[lane]->RunCycles(instructionsPerFrame);
+			}
+		}
+		coreTime += Clock::now() - start;
+		for (size_t i = 0; i < batches.size(); i++) {
+			start = Clock::now();
+			batches[i]->DecreaseTimers();
+			batches[i]->Run(instructionsPerFrame);
+			batchTimes[i] += Clock::now() - start;
+		}
+
+		for (size_t i = 0; i < batches.size(); i++) {
+			for (int lane = 0; lane < lanes; lane++) {
+				if (batches[i]->Exited(lane))
+					continue;
+				//Lanes keep their pc in memory and do not track redraws
+				SuperChip::State laneState;
+				cores[lane]->SaveState(state);
+				batches[i]->SaveLane(lane, laneState);
+				if (!SameState(state, laneState)) {
+					std::cout << "Lane " << lane << " differs on the " << pathNames[batches[i]->Path()] << " path after frame "
+						<< frame << ", pc " << std::hex << state.m_RegPC << " against " << laneState.m_RegPC << std::dec << std::endl;
+					return false;
+				}
+			}
+		}
+	}
+
+	double coreSeconds = std::chrono::duration<double>(coreTime).count();
+	std::cout << lanes << " lanes, " << frames << " frames of " << instructionsPerFrame << " instructions" << std::endl;
+	std::cout << "Separate cores: " << lanes * frames / coreSeconds << " lane frames/s" << std::endl;
+	for (size_t i = 0; i < batches.size(); i++) {
+		const BatchSuperChip& batch = *batches[i];
+		double seconds = std::chrono::duration<double>(batchTimes[i]).count();
+		double laneInstructions = (double)lanes * frames * instructionsPerFrame;
+		std::cout << "Batch " << pathNames[batch.Path()] << ": " << lanes * frames / seconds << " lane frames/s, "
+			<< coreSeconds / seconds << "x, " << 100 * batch.m_VectorInstructions / laneInstructions << "% in groups, "
+			<< 100 * batch.m_IdleInstructions / laneInstructions << "% skipped idle" << std::endl;
+	}
+	std::cout << "All lanes match" << std::endl;
+	return true;
+}
+
+#pragma region Input
+
 // Is called whenever a key is pressed/released via GLFW
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode) {
 	UNREFERENCED_PARAMETER(mode);
@@ -270,6 +903,12 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, GL_TRUE);
+	if (key == GLFW_KEY_TAB && action == GLFW_PRESS)
+		gTurbo = !gTurbo;
+
+	U8 chipKey = gKeyMap.Get(key);
+	if (chipKey != KeyMap::NONE && action != GLFW_REPEAT)
+		gKeyInput.Push(chipKey, action == GLFW_PRESS);
 }
 
 void drop_callback(GLFWwindow* window, int count, const char** paths) {
@@ -277,7 +916,7 @@ void drop_callback(GLFWwindow* window, int count, const char** paths) {
 	for (int i = 0; i < count; i++) {
 		std::cout << paths[i] << std::endl;
 	}
-	emulator.LoadRom(paths[0]);
+	gLoadRom(paths[0]);
 }
 
 #pragma endregion